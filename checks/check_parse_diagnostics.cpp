@@ -0,0 +1,109 @@
+//  *--
+//  check_parse_diagnostics.cpp
+//
+//  Reads a small tray written on the fly whose files contain a malformed
+//  SiPM ID, and checks that it is reported (and skipped) as an index out of
+//  range. The ID 999999-0001_99_11 (column 99, row 11) has a flattened
+//  index inside the tray (11*NCOL + 99), the slot of the SiPM at column 7,
+//  row 15; it must not be written there, and the real line of that SiPM
+//  must not be reported as a duplicate. Covered in
+//    IV_result.txt, SPS_result_onlynumbers.txt - parseTrayText
+//    SPS_result.txt                            - ReadTraySPSVerbose
+//
+//  Usage (from this directory, the tray is written to ../data/check_parse_diagnostics
+//  and removed afterwards):
+//    root -l -b -q check_parse_diagnostics.cpp+
+//  Returns 0 if every file is handled as expected.
+//  *--
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "../src/SiPMDataReader.hpp"
+
+const char* check_directory = "../data/check_parse_diagnostics";
+const char* check_tray      = "999999-0001";
+
+// Write the test tray: the malformed ID first, then the real line of the SiPM whose slot it aliases
+bool writeCheckTray() {
+  std::string tray_directory = std::string(check_directory) + "/" + check_tray + "-results";
+  std::error_code error;
+  std::filesystem::create_directories(tray_directory, error);
+  if (error) return false;
+
+  std::ofstream list(std::string(check_directory) + "/list.txt");
+  list << "$START" << std::endl << check_tray << std::endl;
+
+  std::ofstream IV(tray_directory + "/IV_result.txt");
+  IV << "999999-0001-set0-full 999999-0001_0_0 1759354179 50 1.000 0.000 5.000 0.000 7.000 0.000 5.000 0.100 0.000 0.000 0.000 0.000 0.000 0.000 0.000 0.000" << std::endl;
+  IV << "999999-0001-set0-full 999999-0001_99_11 23.344 0.033 99.0000 99.0000 0.5 11.2 23.34 118.16" << std::endl;
+  IV << "999999-0001-set0-full 999999-0001_7_15 23.352 0.018 38.2721 38.3250 0.2 10.8 23.48 110.58" << std::endl;
+
+  std::ofstream SPS(tray_directory + "/SPS_result_onlynumbers.txt");
+  SPS << "999999-0001_99_11 4 400 99.0000 23.3507 0.00188982 99.000 0.0167039 0.103625 -3505.47 92.865" << std::endl;
+  SPS << "999999-0001_7_15 4 400 37.7083 23.5143 0.00731925 37.7588 0.027671 0.0977943 -3473.82 92.1235" << std::endl;
+
+  std::ofstream SPS_verbose(tray_directory + "/SPS_result.txt");
+  SPS_verbose << "TRAY ID: 999999-0001" << std::endl;
+  SPS_verbose << "SiPM ID: 999999-0001_99_11" << std::endl << "Steepness: 99.000 +/- 9.999" << std::endl << "Gain @ Vbd(25C) + 5V: 999.000" << std::endl;
+  SPS_verbose << "SiPM ID: 999999-0001_7_15" << std::endl << "Steepness: 92.865 +/- 0.491" << std::endl << "Gain @ Vbd(25C) + 5V: 469.529" << std::endl;
+  return IV.good() && SPS.good() && SPS_verbose.good();
+}
+
+// Compare one result and print it if it differs
+bool expect(const char* what, double value, double expected) {
+  bool passed = std::fabs(value - expected) < 1e-3;
+  if (!passed) std::cout << t_red << "Mismatch" << t_def << " in " << what << ": " << value << " (expected " << expected << ")" << std::endl;
+  return passed;
+}
+
+int check_parse_diagnostics() {
+  if (!writeCheckTray()) {
+    std::cout << t_red << "Error" << t_def << " in <check_parse_diagnostics>: Could not write the test tray to " << check_directory << "." << std::endl;
+    return 1;
+  }
+
+  SiPMDataReader* reader = new SiPMDataReader();
+  reader->SetQuiet();
+  reader->SetNoCache();
+  reader->SetReadVerboseSPS();
+  reader->SetSubDirectory("check_parse_diagnostics");
+  reader->ReadFile((std::string(check_directory) + "/list.txt").c_str());
+  reader->ReadDataIV();
+  reader->ReadDataSPS();
+  reader->PrintDiagnostics();
+
+  bool passed = reader->GetIV()->size() == 1 && reader->GetSPS()->size() == 1;
+  if (passed) {
+    ParseDiagnostics* diagnostics = reader->GetDiagnostics();
+    IV_data*  IV  = reader->GetIV()->at(0);
+    SPS_data* SPS = reader->GetSPS()->at(0);
+    int i = 15*NCOL + 7;
+
+    // One out of range ID per file, no duplicate
+    passed &= expect("out of range IDs", diagnostics->GetNIssues(kIssueIndexOutOfRange), 3);
+    passed &= expect("duplicate SiPMs",  diagnostics->GetNIssues(kIssueDuplicateSiPM), 0);
+    passed &= expect("issues",           diagnostics->GetNIssues(), 3);
+
+    // The aliased slot holds the real line of its SiPM
+    passed &= expect("row",            IV->row[i], 15);
+    passed &= expect("column",         IV->col[i], 7);
+    passed &= expect("IV V_peak",      IV->IV_Vpeak[i], 38.2721);
+    passed &= expect("SPS V_bd",       SPS->SPS_Vbd[i], 37.7083);
+    passed &= expect("SPS steepness",  SPS->SPS_steepness_unc[i], 0.491);
+    passed &= expect("SPS gain",       SPS->SPS_gain[i], 469.529);
+  } else std::cout << t_red << "Error" << t_def << " in <check_parse_diagnostics>: The test tray was not read." << std::endl;
+  delete reader;
+
+  std::error_code error;
+  std::filesystem::remove_all(check_directory, error);
+
+  std::cout << (passed ? t_grn : t_red) << (passed ? "PASSED" : "FAILED") << t_def << std::endl;
+  return passed ? 0 : 1;
+}// End of check_parse_diagnostics
+
+// Standalone build (see the README)
+#ifdef SiPM_check_main
+int main() {return check_parse_diagnostics();}
+#endif
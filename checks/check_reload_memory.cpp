@@ -0,0 +1,132 @@
+//  *--
+//  check_reload_memory.cpp
+//
+//  Reloads a tray list many times with one SiPMDataReader and checks that
+//  the resident memory stays flat, i.e. that ReadFile, ReadDataIV/ReadDataSPS
+//  and AppendFile free the data they replace. Every cycle is
+//    ReadFile, ReadDataIV, ReadDataSPS  - full reload (frees the trays and data)
+//    ReadDataIV, ReadDataSPS            - re-read over loaded data
+//    AppendFile                         - append (nothing new) to loaded trays
+//  The first n_warmup cycles fill the allocator and the tray caches; after
+//  them the resident size may grow by at most max_growth_kB over n_reloads
+//  cycles. A leak of one tray set per cycle grows far beyond that.
+//
+//  Usage (from this directory, the trays are read from ../data):
+//    root -l -b -q 'check_reload_memory.cpp+("../data/batch_traylist_production.txt", 200)'
+//  Returns 0 if the growth stays within the bound. For an exact leak report,
+//  build it standalone with -fsanitize=address (see the README); LeakSanitizer
+//  then lists any allocation still unreferenced at exit and fails the run.
+//  AddressSanitizer holds freed memory in quarantine, so in such a build the
+//  growth is printed but not checked.
+//  *--
+
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include "../src/SiPMDataReader.hpp"
+
+// AddressSanitizer build (gcc defines __SANITIZE_ADDRESS__, clang has __has_feature)
+#if defined(__SANITIZE_ADDRESS__)
+#define SiPM_check_asan
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SiPM_check_asan
+#endif
+#endif
+
+// Resident set size of this process in kB (-1 if not available)
+long residentKB() {
+#ifdef __APPLE__
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return -1;
+  return info.resident_size / 1024;
+#else
+  std::ifstream statm("/proc/self/statm");
+  long size, resident;
+  if (!(statm >> size >> resident)) return -1;
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+// Discards what is written to it (reader messages repeated every cycle)
+class NullBuffer : public std::streambuf {
+protected:
+  int overflow(int c) {return c;}
+};// End of NullBuffer
+
+// One reload cycle over tray_list
+void reloadCycle(SiPMDataReader* reader, const char* tray_list) {
+  reader->ReadFile(tray_list);
+  reader->ReadDataIV();
+  reader->ReadDataSPS();
+  reader->ReadDataIV();
+  reader->ReadDataSPS();
+  reader->AppendFile(tray_list);
+}
+
+int check_reload_memory(const char* tray_list = "../data/batch_traylist_production.txt", int n_reloads = 200, int n_warmup = 5, long max_growth_kB = 4096) {
+  SiPMDataReader* reader = new SiPMDataReader();
+  reader->SetQuiet();
+
+  // Only the first cycle prints the reader's messages (missing trays, nothing to append)
+  NullBuffer null_buffer;
+  std::streambuf* cout_buffer = std::cout.rdbuf();
+  std::streambuf* cerr_buffer = std::cerr.rdbuf();
+  long start_kB = residentKB();
+  for (int i = 0; i < n_warmup; ++i) {
+    reloadCycle(reader, tray_list);
+    std::cout.rdbuf(&null_buffer);
+    std::cerr.rdbuf(&null_buffer);
+  }
+  long warm_kB = residentKB();
+  std::cout.rdbuf(cout_buffer);
+  std::cerr.rdbuf(cerr_buffer);
+  if (start_kB < 0 || warm_kB < 0) {
+    std::cout << t_red << "Error" << t_def << " in <check_reload_memory>: Resident memory size not available on this system." << std::endl;
+    delete reader;
+    return 1;
+  }
+  if (reader->GetTrayStrings()->empty()) {
+    std::cout << t_red << "Error" << t_def << " in <check_reload_memory>: No trays read from {" << tray_list << "}; run from checks/ with a list of trays in ../data." << std::endl;
+    delete reader;
+    return 1;
+  }
+  std::cout << "Loaded " << t_blu << reader->GetTrayStrings()->size() << t_def << " tray entries from " << tray_list;
+  std::cout << ", resident size " << warm_kB << " kB after " << n_warmup << " warm-up cycles (" << start_kB << " kB before)" << std::endl;
+
+  for (int i = 0; i < n_reloads; ++i) {
+    std::cout.rdbuf(&null_buffer);
+    std::cerr.rdbuf(&null_buffer);
+    reloadCycle(reader, tray_list);
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+    if ((i + 1) % 50 == 0) std::cout << "  cycle " << i + 1 << ": " << residentKB() << " kB" << std::endl;
+  }
+  long growth_kB = residentKB() - warm_kB;
+  delete reader;
+
+  std::cout << "Growth over " << n_reloads << " reload cycles: " << growth_kB << " kB (bound " << max_growth_kB << " kB)" << std::endl;
+#ifdef SiPM_check_asan
+  std::cout << "AddressSanitizer build: growth not checked, leaks are reported by LeakSanitizer at exit" << std::endl;
+  bool passed = true;
+#else
+  bool passed = growth_kB <= max_growth_kB;
+#endif
+  std::cout << (passed ? t_grn : t_red) << (passed ? "PASSED" : "FAILED") << t_def << std::endl;
+  return passed ? 0 : 1;
+}// End of check_reload_memory
+
+// Standalone build (see the README)
+#ifdef SiPM_check_main
+int main(int argc, char** argv) {
+  if (argc > 2) return check_reload_memory(argv[1], atoi(argv[2]));
+  if (argc > 1) return check_reload_memory(argv[1]);
+  return check_reload_memory();
+}
+#endif
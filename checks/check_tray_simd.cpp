@@ -0,0 +1,102 @@
+//  *--
+//  check_tray_simd.cpp
+//
+//  Compares the vector kernels of SiPMTraySimd.hpp (the level picked for
+//  this CPU: AVX2 or NEON) against the scalar kernels of SiPMTrayStats.hpp
+//  on random tray columns. The masks are random, with the last valid entry
+//  anywhere in the column (so not a multiple of the 8/4-entry blocks), and
+//  the invalid entries hold garbage (-999, NaN, large values) that must not
+//  leak into the results.
+//    counts (above a limit, outside a window) - must be identical
+//    sums (sum, sum of squared deviations)     - relative difference below sum_tolerance
+//
+//  Usage (from this directory):
+//    root -l -b -q 'check_tray_simd.cpp+(20000)'
+//  Returns 0 if every comparison passes. On a CPU without vector kernels it
+//  compares the scalar kernels with themselves.
+//  *--
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+#include "../src/SiPMTrayStats.hpp"
+
+const double sum_tolerance = 1e-12;  // Documented agreement is ~1e-15; anything near this is a bug
+
+// Relative difference, safe for sums near zero
+double relativeDifference(double a, double b) {
+  double scale = std::max(std::fabs(a), std::fabs(b));
+  return scale < 1e-300 ? 0 : std::fabs(a - b) / scale;
+}
+
+int check_tray_simd(int n_columns = 20000, unsigned seed = 1) {
+  TraySimdLevel detected = detectTraySimdLevel();
+  const char* level_names[3] = {"scalar", "AVX2", "NEON"};
+  std::cout << "Vector kernels: " << t_blu << level_names[detected] << t_def << ", " << n_columns << " random columns" << std::endl;
+
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> voltage(37.5, 38.5);
+  std::uniform_real_distribution<double> unit(0, 1);
+  const float garbage[4] = {-999, NAN, 1e30f, -1e30f};
+
+  alignas(64) float values[tray_column_stride];
+  uint64_t mask[tray_mask_words];
+  int n_count_mismatches = 0;
+  int n_sum_failures = 0;
+  double max_sum_difference = 0;
+
+  for (int i_column = 0; i_column < n_columns; ++i_column) {
+    // Valid entries only in [0, n_filled): the tail length varies over the whole column
+    int n_filled = generator() % (tray_column_stride + 1);
+    double density = unit(generator);
+    for (int w = 0; w < tray_mask_words; ++w) mask[w] = 0;
+    for (int i = 0; i < tray_column_stride; ++i) {
+      bool valid = i < n_filled && unit(generator) < density;
+      if (valid) mask[i >> 6] |= uint64_t(1) << (i & 63);
+      values[i] = valid ? voltage(generator) : garbage[generator() % 4];
+    }
+    double center = 38 + 0.1*(unit(generator) - 0.5);
+    double half_width = 0.05*unit(generator);
+    float  limit = voltage(generator);
+
+    // Same calls through the dispatch, at the detected level and at the scalar level
+    double sum[2], sum_squared_deviation[2];
+    int    count_above[2], count_outside[2];
+    for (int pass = 0; pass < 2; ++pass) {
+      traySimdLevel() = pass == 0 ? detected : kSimdScalar;
+      sum[pass]                   = maskedSum(values, mask);
+      sum_squared_deviation[pass] = maskedSumSquaredDeviation(values, mask, center);
+      count_above[pass]           = maskedCountAbove(values, mask, limit);
+      count_outside[pass]         = maskedCountOutside(values, mask, center, half_width);
+    }
+    traySimdLevel() = detected;
+
+    if (count_above[0] != count_above[1] || count_outside[0] != count_outside[1]) {
+      if (n_count_mismatches++ < 5) {
+        std::cout << t_red << "Mismatch" << t_def << " in column " << i_column << ": above " << count_above[0] << " vs " << count_above[1]
+                  << ", outside " << count_outside[0] << " vs " << count_outside[1] << std::endl;
+      }
+    }
+    double difference = std::max(relativeDifference(sum[0], sum[1]), relativeDifference(sum_squared_deviation[0], sum_squared_deviation[1]));
+    max_sum_difference = std::max(max_sum_difference, difference);
+    if (!(difference <= sum_tolerance)) {
+      if (n_sum_failures++ < 5) {
+        std::cout << t_red << "Sum difference" << t_def << " in column " << i_column << ": " << sum[0] << " vs " << sum[1]
+                  << ", " << sum_squared_deviation[0] << " vs " << sum_squared_deviation[1] << std::endl;
+      }
+    }
+  }// End of column loop
+
+  std::cout << "Count mismatches: " << n_count_mismatches << ", sums over tolerance: " << n_sum_failures
+            << ", largest relative sum difference: " << max_sum_difference << std::endl;
+  bool passed = n_count_mismatches == 0 && n_sum_failures == 0;
+  std::cout << (passed ? t_grn : t_red) << (passed ? "PASSED" : "FAILED") << t_def << std::endl;
+  return passed ? 0 : 1;
+}// End of check_tray_simd
+
+// Standalone build (see the README)
+#ifdef SiPM_check_main
+int main(int argc, char** argv) {return check_tray_simd(argc > 1 ? atoi(argv[1]) : 20000);}
+#endif
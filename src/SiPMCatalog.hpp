@@ -0,0 +1,350 @@
+//  *--
+//  SiPMCatalog.hpp
+//
+//  Local SQLite catalog of every tested SiPM, for ad-hoc questions such as
+//  "all SiPMs of batch 251113 with Idark(+4V) > 15 nA and |dVbd| > 40 mV"
+//  without writing a macro that rescans every tray.
+//  The loaded IV_data/SPS_data are mirrored into two tables:
+//    tray - one row per tray entry (tray, mode, batch, note, IV test time, averages,
+//           and which of the IV/SPS results it holds)
+//    sipm - one row per SiPM per tray entry, every IV and SPS quantity, plus
+//           dVpeak/dVbd, the deviation from its tray's average (25C corrected)
+//  indexed on tray, batch, mode and the key quantities.
+//  Trays already in the catalog are skipped, so a growing batch list can
+//  be added again as new trays arrive; a tray catalogued before all of its
+//  results existed (e.g. IV only) is filled in once the reader has the rest.
+//  Failed measurements are NULL.
+//
+//  Needs SQLite 3 (in ROOT: gSystem->Load("libsqlite3") before including).
+//
+//  Usage (after ReadDataIV/ReadDataSPS):
+//    SiPMCatalog catalog("../data/catalog.sqlite");
+//    catalog.AddTrays();
+//    std::vector<CatalogSiPM> sipms;
+//    catalog.Select("batch = '251113' AND Idark_4above > 15 AND ABS(dVbd) > 0.040", sipms);
+//  *--
+
+#ifndef SiPMCatalog_h
+#define SiPMCatalog_h
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "global_vars.hpp"
+#include "SiPMDataReader.hpp"
+
+// Key quantities of one catalogued SiPM (other columns: see SiPMCatalog::Query)
+struct CatalogSiPM {
+  std::string tray;
+  int         mode;           // 0 cassette, 1 robot
+  int         row, col, index;
+  double      IV_Vpeak_25C;   // -999 where NULL
+  double      Idark_4above;
+  double      SPS_Vbd_25C;
+  double      dVpeak;         // Deviation from the tray average
+  double      dVbd;
+};// structdef :: CatalogSiPM
+
+//========================================================================== SiPMCatalog
+
+class SiPMCatalog {
+private:
+  sqlite3* db;
+  std::string path;
+
+  // Run statements without results; prints the SQLite error on failure
+  bool Execute(const char* sql, const char* where) {
+    char* message = NULL;
+    if (sqlite3_exec(this->db, sql, NULL, NULL, &message) == SQLITE_OK) return true;
+    std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::" << where << ">: " << (message ? message : "unknown SQLite error") << std::endl;
+    sqlite3_free(message);
+    return false;
+  }
+
+  sqlite3_stmt* Prepare(const std::string& sql, const char* where) {
+    sqlite3_stmt* statement = NULL;
+    if (sqlite3_prepare_v2(this->db, sql.c_str(), -1, &statement, NULL) != SQLITE_OK) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::" << where << ">: " << sqlite3_errmsg(this->db) << std::endl;
+      return NULL;
+    }
+    return statement;
+  }
+
+  // -999 and NaN are stored as NULL
+  static void BindValue(sqlite3_stmt* statement, int column, double value) {
+    if (value == -999 || std::isnan(value)) sqlite3_bind_null(statement, column);
+    else                                    sqlite3_bind_double(statement, column, value);
+  }
+
+  static double ColumnValue(sqlite3_stmt* statement, int column) {
+    return sqlite3_column_type(statement, column) == SQLITE_NULL ? -999 : sqlite3_column_double(statement, column);
+  }
+
+  // Tray average of the valid entries of a column (NaN if none)
+  template <class Column>
+  static double Average(const Column& values) {
+    double sum = 0;
+    int n = 0;
+    for (int i = 0; i < NROW*NCOL; ++i) {
+      if (values[i] == -999 || std::isnan(values[i])) continue;
+      sum += values[i];
+      ++n;
+    }
+    return sum / n;
+  }
+
+  bool CreateSchema() {
+    return Execute(
+      "PRAGMA journal_mode = WAL;"
+      "CREATE TABLE IF NOT EXISTS tray ("
+      "  tray TEXT NOT NULL, mode INTEGER NOT NULL, batch TEXT NOT NULL, tray_note TEXT, test_time INTEGER,"
+      "  avg_Vpeak_25C REAL, avg_Vbd_25C REAL, has_IV INTEGER NOT NULL DEFAULT 0, has_SPS INTEGER NOT NULL DEFAULT 0,"
+      "  PRIMARY KEY (tray, mode));"
+      "CREATE TABLE IF NOT EXISTS sipm ("
+      "  tray TEXT NOT NULL, mode INTEGER NOT NULL, batch TEXT NOT NULL,"
+      "  row INTEGER, col INTEGER, idx INTEGER NOT NULL, test_set INTEGER, test_position INTEGER,"
+      "  IV_avg_temp REAL, IV_stdev_temp REAL, IV_Vpeak REAL, IV_Vpeak_25C REAL,"
+      "  Idark_3below REAL, Idark_4above REAL, Idark_temp REAL, forward_res REAL,"
+      "  SPS_npeaks INTEGER, SPS_avg_temp REAL, SPS_stdev_temp REAL, SPS_peakwidth REAL,"
+      "  SPS_Vbd REAL, SPS_Vbd_25C REAL, SPS_Vbd_unc REAL, SPS_chi2ndf REAL,"
+      "  fit_parm_0 REAL, fit_parm_1 REAL, SPS_steepness_unc REAL, SPS_gain REAL,"
+      "  dVpeak REAL, dVbd REAL, PRIMARY KEY (tray, mode, idx));"
+      "CREATE INDEX IF NOT EXISTS sipm_batch  ON sipm (batch);"
+      "CREATE INDEX IF NOT EXISTS sipm_mode   ON sipm (mode);"
+      "CREATE INDEX IF NOT EXISTS sipm_Idark  ON sipm (Idark_4above);"
+      "CREATE INDEX IF NOT EXISTS sipm_Vpeak  ON sipm (IV_Vpeak_25C);"
+      "CREATE INDEX IF NOT EXISTS sipm_Vbd    ON sipm (SPS_Vbd_25C);"
+      "CREATE INDEX IF NOT EXISTS sipm_dVpeak ON sipm (dVpeak);"
+      "CREATE INDEX IF NOT EXISTS sipm_dVbd   ON sipm (dVbd);"
+      "CREATE INDEX IF NOT EXISTS tray_batch  ON tray (batch);",
+      "CreateSchema");
+  }// End of SiPMCatalog::CreateSchema
+
+public:
+  SiPMCatalog() : db(NULL) {}
+  SiPMCatalog(const char* filename) : db(NULL) {Open(filename);}
+  ~SiPMCatalog() {Close();}
+
+  // Open (or create) the catalog file
+  bool Open(const char* filename) {
+    Close();
+    if (sqlite3_open(filename, &this->db) != SQLITE_OK) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::Open>: could not open " << filename << ": " << sqlite3_errmsg(this->db) << std::endl;
+      Close();
+      return false;
+    }
+    this->path = filename;
+    if (!CreateSchema()) {Close(); return false;}
+    return true;
+  }
+
+  void Close() {
+    if (this->db) sqlite3_close(this->db);
+    this->db = NULL;
+    this->path.clear();
+  }
+
+  bool               IsOpen()  {return this->db != NULL;}
+  const std::string& GetPath() {return this->path;}
+
+  // *---------------- Loading
+
+  // Add the tray entries loaded in reader that are not catalogued yet (all of them if replace).
+  // A catalogued entry is written again if the reader now has results (IV or SPS) it lacks,
+  // as long as the reader also still has the ones it holds.
+  // One transaction per call. Returns the number of tray entries added or updated, -1 on error.
+  int AddTrays(SiPMDataReader* reader = gReader, bool replace = false) {
+    if (!this->db || !reader) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::AddTrays>: " << (this->db ? "no reader given." : "catalog is not open.") << std::endl;
+      return -1;
+    }
+    std::vector<std::string>* tray_strings = reader->GetTrayStrings();
+    std::vector<int>*         tray_modes   = reader->GetTrayModes();
+    std::vector<IV_data*>*    IV_trays     = reader->GetIV();
+    std::vector<SPS_data*>*   SPS_trays    = reader->GetSPS();
+
+    sqlite3_stmt* find_tray   = Prepare("SELECT has_IV, has_SPS FROM tray WHERE tray = ?1 AND mode = ?2", "AddTrays");
+    sqlite3_stmt* delete_tray = Prepare("DELETE FROM tray WHERE tray = ?1 AND mode = ?2", "AddTrays");
+    sqlite3_stmt* delete_sipm = Prepare("DELETE FROM sipm WHERE tray = ?1 AND mode = ?2", "AddTrays");
+    sqlite3_stmt* insert_tray = Prepare("INSERT INTO tray VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9)", "AddTrays");
+    sqlite3_stmt* insert_sipm = Prepare("INSERT INTO sipm VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10,"
+                                        " ?11, ?12, ?13, ?14, ?15, ?16, ?17, ?18, ?19, ?20,"
+                                        " ?21, ?22, ?23, ?24, ?25, ?26, ?27, ?28, ?29, ?30)", "AddTrays");
+    int n_added = 0;
+    bool ok = find_tray && delete_tray && delete_sipm && insert_tray && insert_sipm && Execute("BEGIN", "AddTrays");
+    for (int i_tray = 0; ok && i_tray < tray_strings->size(); ++i_tray) {
+      const std::string& tray = tray_strings->at(i_tray);
+      const std::string  batch = SiPMDataReader::BatchLabel(tray);
+      int mode = tray_modes->at(i_tray);
+      IV_data*  IV  = i_tray < IV_trays->size()  ? IV_trays->at(i_tray)  : NULL;
+      SPS_data* SPS = i_tray < SPS_trays->size() ? SPS_trays->at(i_tray) : NULL;
+      if (!IV && !SPS) continue;
+
+      // Incremental: skip catalogued trays unless the reader has results they lack
+      bool catalogued = false;
+      if (!replace) {
+        sqlite3_reset(find_tray);
+        sqlite3_bind_text(find_tray, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(find_tray, 2, mode);
+        if (sqlite3_step(find_tray) == SQLITE_ROW) {
+          bool has_IV  = sqlite3_column_int(find_tray, 0);
+          bool has_SPS = sqlite3_column_int(find_tray, 1);
+          if ((has_IV || !IV) && (has_SPS || !SPS)) continue;  // Nothing new
+          if ((has_IV && !IV) || (has_SPS && !SPS)) {
+            std::cout << t_red << "Warning" << t_def << " in <SiPMCatalog::AddTrays>: tray " << tray << " is catalogued with "
+                      << (has_IV ? "IV" : "SPS") << " results the reader does not hold; read both to update it." << std::endl;
+            continue;
+          }
+          catalogued = true;
+        }
+      }
+
+      // Drop the previous rows when replacing or filling in
+      if (replace || catalogued) {
+        sqlite3_reset(delete_tray);
+        sqlite3_bind_text(delete_tray, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(delete_tray, 2, mode);
+        sqlite3_step(delete_tray);
+        sqlite3_reset(delete_sipm);
+        sqlite3_bind_text(delete_sipm, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(delete_sipm, 2, mode);
+        sqlite3_step(delete_sipm);
+      }
+
+      double avg_Vpeak = IV  ? Average(IV->IV_Vpeak_25C)  : NAN;
+      double avg_Vbd   = SPS ? Average(SPS->SPS_Vbd_25C)  : NAN;
+      sqlite3_reset(insert_tray);
+      sqlite3_bind_text(insert_tray, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int(insert_tray, 2, mode);
+      sqlite3_bind_text(insert_tray, 3, batch.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_text(insert_tray, 4, (IV ? IV->tray_note : SPS->tray_note).c_str(), -1, SQLITE_TRANSIENT);
+      if (IV && IV->parameters.valid) sqlite3_bind_int64(insert_tray, 5, IV->parameters.timestamp);
+      else                            sqlite3_bind_null(insert_tray, 5);
+      BindValue(insert_tray, 6, avg_Vpeak);
+      BindValue(insert_tray, 7, avg_Vbd);
+      sqlite3_bind_int(insert_tray, 8, IV  != NULL);
+      sqlite3_bind_int(insert_tray, 9, SPS != NULL);
+      ok = sqlite3_step(insert_tray) == SQLITE_DONE;
+
+      for (int i = 0; ok && i < NROW*NCOL; ++i) {
+        // Only SiPMs that appear in at least one of the files
+        bool in_IV  = IV  && IV->row[i]  != -999;
+        bool in_SPS = SPS && SPS->row[i] != -999;
+        if (!in_IV && !in_SPS) continue;
+
+        sqlite3_reset(insert_sipm);
+        sqlite3_bind_text(insert_sipm, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(insert_sipm, 2, mode);
+        sqlite3_bind_text(insert_sipm, 3, batch.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(insert_sipm, 4, i/NCOL);
+        sqlite3_bind_int(insert_sipm, 5, i%NCOL);
+        sqlite3_bind_int(insert_sipm, 6, i);
+        sqlite3_bind_int(insert_sipm, 7, i/32);
+        sqlite3_bind_int(insert_sipm, 8, i%32);
+        BindValue(insert_sipm,  9, in_IV ? IV->avg_temp[i]     : -999);
+        BindValue(insert_sipm, 10, in_IV ? IV->stdev_temp[i]   : -999);
+        BindValue(insert_sipm, 11, in_IV ? IV->IV_Vpeak[i]     : -999);
+        BindValue(insert_sipm, 12, in_IV ? IV->IV_Vpeak_25C[i] : -999);
+        BindValue(insert_sipm, 13, in_IV ? IV->Idark_3below[i] : -999);
+        BindValue(insert_sipm, 14, in_IV ? IV->Idark_4above[i] : -999);
+        BindValue(insert_sipm, 15, in_IV ? IV->Idark_temp[i]   : -999);
+        BindValue(insert_sipm, 16, in_IV ? IV->forward_res[i]  : -999);
+        BindValue(insert_sipm, 17, in_SPS ? SPS->SPS_npeaks[i]        : -999);
+        BindValue(insert_sipm, 18, in_SPS ? SPS->avg_temp[i]          : -999);
+        BindValue(insert_sipm, 19, in_SPS ? SPS->stdev_temp[i]        : -999);
+        BindValue(insert_sipm, 20, in_SPS ? SPS->SPS_peakwidth[i]     : -999);
+        BindValue(insert_sipm, 21, in_SPS ? SPS->SPS_Vbd[i]           : -999);
+        BindValue(insert_sipm, 22, in_SPS ? SPS->SPS_Vbd_25C[i]       : -999);
+        BindValue(insert_sipm, 23, in_SPS ? SPS->SPS_Vbd_unc[i]       : -999);
+        BindValue(insert_sipm, 24, in_SPS ? SPS->SPS_chi2ndf[i]       : -999);
+        BindValue(insert_sipm, 25, in_SPS ? SPS->fit_parm_0[i]        : -999);
+        BindValue(insert_sipm, 26, in_SPS ? SPS->fit_parm_1[i]        : -999);
+        BindValue(insert_sipm, 27, in_SPS ? SPS->SPS_steepness_unc[i] : -999);
+        BindValue(insert_sipm, 28, in_SPS ? SPS->SPS_gain[i]          : -999);
+        BindValue(insert_sipm, 29, in_IV  && IV->IV_Vpeak_25C[i] != -999 ? IV->IV_Vpeak_25C[i] - avg_Vpeak : -999);
+        BindValue(insert_sipm, 30, in_SPS && SPS->SPS_Vbd_25C[i] != -999 ? SPS->SPS_Vbd_25C[i] - avg_Vbd  : -999);
+        ok = sqlite3_step(insert_sipm) == SQLITE_DONE;
+      }// End of SiPM loop
+      if (ok) ++n_added;
+      else    std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::AddTrays>: " << sqlite3_errmsg(this->db) << " (tray " << tray << ")" << std::endl;
+    }// End of tray loop
+
+    sqlite3_finalize(find_tray);
+    sqlite3_finalize(delete_tray);
+    sqlite3_finalize(delete_sipm);
+    sqlite3_finalize(insert_tray);
+    sqlite3_finalize(insert_sipm);
+    if (!ok) {
+      Execute("ROLLBACK", "AddTrays");
+      return -1;
+    }
+    if (!Execute("COMMIT", "AddTrays")) return -1;
+    return n_added;
+  }// End of SiPMCatalog::AddTrays
+
+  // *---------------- Queries
+
+  // Run any SQL statement; on_row(statement) is called for every result row
+  // (read it with sqlite3_column_*). Returns the number of rows, -1 on error.
+  int Query(const std::string& sql, std::function<void(sqlite3_stmt*)> on_row = NULL) {
+    if (!this->db) return -1;
+    sqlite3_stmt* statement = Prepare(sql, "Query");
+    if (!statement) return -1;
+    int n_rows = 0, status;
+    while ((status = sqlite3_step(statement)) == SQLITE_ROW) {
+      if (on_row) on_row(statement);
+      ++n_rows;
+    }
+    if (status != SQLITE_DONE) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMCatalog::Query>: " << sqlite3_errmsg(this->db) << std::endl;
+      n_rows = -1;
+    }
+    sqlite3_finalize(statement);
+    return n_rows;
+  }// End of SiPMCatalog::Query
+
+  // SiPMs matching an SQL condition on the sipm table, e.g. "batch = '251113' AND Idark_4above > 15"
+  // Results are appended to sipms in tray, mode, index order. Returns their number, -1 on error.
+  int Select(const std::string& condition, std::vector<CatalogSiPM>& sipms) {
+    return Query("SELECT tray, mode, row, col, idx, IV_Vpeak_25C, Idark_4above, SPS_Vbd_25C, dVpeak, dVbd FROM sipm"
+                 " WHERE " + condition + " ORDER BY tray, mode, idx",
+                 [&sipms](sqlite3_stmt* statement) {
+      CatalogSiPM sipm;
+      sipm.tray.assign(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)));
+      sipm.mode         = sqlite3_column_int(statement, 1);
+      sipm.row          = sqlite3_column_int(statement, 2);
+      sipm.col          = sqlite3_column_int(statement, 3);
+      sipm.index        = sqlite3_column_int(statement, 4);
+      sipm.IV_Vpeak_25C = ColumnValue(statement, 5);
+      sipm.Idark_4above = ColumnValue(statement, 6);
+      sipm.SPS_Vbd_25C  = ColumnValue(statement, 7);
+      sipm.dVpeak       = ColumnValue(statement, 8);
+      sipm.dVbd         = ColumnValue(statement, 9);
+      sipms.push_back(sipm);
+    });
+  }// End of SiPMCatalog::Select
+
+  // Number of SiPMs matching an SQL condition on the sipm table, -1 on error
+  int Count(const std::string& condition) {
+    int count = -1;
+    Query("SELECT COUNT(*) FROM sipm WHERE " + condition, [&count](sqlite3_stmt* statement) {count = sqlite3_column_int(statement, 0);});
+    return count;
+  }
+
+  // Is (tray, mode) catalogued?
+  bool HasTray(const std::string& tray, int mode = 0) {
+    sqlite3_stmt* statement = this->db ? Prepare("SELECT 1 FROM tray WHERE tray = ?1 AND mode = ?2", "HasTray") : NULL;
+    if (!statement) return false;
+    sqlite3_bind_text(statement, 1, tray.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(statement, 2, mode);
+    bool found = sqlite3_step(statement) == SQLITE_ROW;
+    sqlite3_finalize(statement);
+    return found;
+  }
+};// End of SiPMCatalog
+
+#endif /* SiPMCatalog_h */
@@ -0,0 +1,134 @@
+//  *--
+//  SiPMDataManifest.hpp
+//
+//  In-memory index of the tray result directories in a data directory.
+//  The directory is listed once (plus one listing per result directory),
+//  after which checking a tray or resolving its directories is a hash
+//  lookup instead of a series of stat() calls on the (network) share.
+//  *--
+
+#ifndef SiPMDataManifest_h
+#define SiPMDataManifest_h
+
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+// Result files a tray directory may contain
+enum TrayFileFlags {
+  kFileIV         = 1 << 0,   // IV_result.txt
+  kFileSPSNumbers = 1 << 1,   // SPS_result_onlynumbers.txt
+  kFileSPSVerbose = 1 << 2    // SPS_result.txt (not required)
+};
+const unsigned tray_required_files = kFileIV | kFileSPSNumbers;
+
+// Where a tray's cassette and robot results live, and which files each has
+struct TrayLocation {
+  std::string cassette_dir;
+  std::string robot_dir;
+  unsigned    cassette_files;   // TrayFileFlags, 0 if the directory does not exist
+  unsigned    robot_files;
+
+  bool HasCassette() const {return (cassette_files & tray_required_files) == tray_required_files;}
+  bool HasRobot()    const {return (robot_files & tray_required_files) == tray_required_files;}
+};// structdef :: TrayLocation
+
+//========================================================================== TrayManifest
+
+class TrayManifest {
+private:
+  std::string data_dir;                                   // Directory that was scanned
+  std::unordered_map<std::string, unsigned> directories;  // Subdirectory name -> TrayFileFlags
+
+  // Is this entry of directory_path a directory / regular file?
+  // Uses d_type where the filesystem provides it, and stat() otherwise.
+  static bool IsType(const std::string& directory_path, struct dirent* entry, bool want_directory) {
+#ifdef DT_UNKNOWN
+    if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) return want_directory ? entry->d_type == DT_DIR : entry->d_type != DT_DIR;
+#endif
+    struct stat info;
+    if (stat((directory_path + "/" + entry->d_name).c_str(), &info) != 0) return false;
+    return want_directory ? S_ISDIR(info.st_mode) : !S_ISDIR(info.st_mode);
+  }
+
+  // List one result directory and flag the result files it holds
+  static unsigned ScanResultFiles(const std::string& directory_path) {
+    unsigned files = 0;
+    DIR* dir = opendir(directory_path.c_str());
+    if (!dir) return files;
+    while (struct dirent* entry = readdir(dir)) {
+      unsigned flag = 0;
+      if      (strcmp(entry->d_name, "IV_result.txt") == 0)              flag = kFileIV;
+      else if (strcmp(entry->d_name, "SPS_result_onlynumbers.txt") == 0) flag = kFileSPSNumbers;
+      else if (strcmp(entry->d_name, "SPS_result.txt") == 0)             flag = kFileSPSVerbose;
+      if (flag && IsType(directory_path, entry, false)) files |= flag;
+    }closedir(dir);
+    return files;
+  }
+
+public:
+  // Index every subdirectory of data_directory, replacing any previous scan.
+  // Returns false if data_directory cannot be listed.
+  bool Scan(const std::string& data_directory) {
+    this->data_dir = data_directory;
+    this->directories.clear();
+
+    DIR* dir = opendir(data_directory.c_str());
+    if (!dir) return false;
+    while (struct dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] == '.') continue;
+      if (!IsType(data_directory, entry, true)) continue;
+      this->directories[entry->d_name] = ScanResultFiles(data_directory + "/" + entry->d_name);
+    }closedir(dir);
+    return true;
+  }// End of TrayManifest::Scan
+
+  // Start an index filled by hand (e.g. from an archive, see SiPMTrayArchive.hpp)
+  void Clear(const std::string& data_directory) {
+    this->data_dir = data_directory;
+    this->directories.clear();
+  }
+  void AddDirectory(const std::string& directory_name, unsigned files) {this->directories[directory_name] = files;}
+
+  // Re-list a single subdirectory, e.g. one that may have appeared since the last Scan
+  void Refresh(const std::string& directory_name) {
+    if (directory_name.find('/') != std::string::npos) return; // Nested names are never cached
+    unsigned files = ScanResultFiles(this->data_dir + "/" + directory_name);
+    if (files) this->directories[directory_name] = files;
+    else       this->directories.erase(directory_name);
+  }
+
+  // Result files found in a subdirectory (0 if it does not exist)
+  // Nested names ("a/b") are not in the index and are listed directly.
+  unsigned GetFiles(const std::string& directory_name) const {
+    if (directory_name.find('/') != std::string::npos) return ScanResultFiles(this->data_dir + "/" + directory_name);
+    std::unordered_map<std::string, unsigned>::const_iterator it = this->directories.find(directory_name);
+    return it == this->directories.end() ? 0 : it->second;
+  }
+
+  // Directory name of a tray's results under the naming convention in use:
+  //   {tray}[-robot][-results]
+  static std::string DirectoryName(const std::string& tray, bool robot, bool has_subscript_results) {
+    std::string name = tray;
+    if (robot)                 name += "-robot";
+    if (has_subscript_results) name += "-results";
+    return name;
+  }
+
+  // Cassette and robot directories of a tray, and the files in each
+  TrayLocation Lookup(const std::string& tray, bool has_subscript_results) const {
+    TrayLocation location;
+    location.cassette_dir   = DirectoryName(tray, false, has_subscript_results);
+    location.robot_dir      = DirectoryName(tray, true, has_subscript_results);
+    location.cassette_files = GetFiles(location.cassette_dir);
+    location.robot_files    = GetFiles(location.robot_dir);
+    return location;
+  }
+
+  const std::string& GetDataDir()      const {return this->data_dir;}
+  int                GetNDirectories() const {return this->directories.size();}
+};// End of TrayManifest
+
+#endif /* SiPMDataManifest_h */
@@ -11,6 +11,18 @@
 #define SiPMDataReader_t
 
 #include "global_vars.hpp"
+#include "SiPMTextParser.hpp"
+#include "SiPMTrayBlock.hpp"
+#include "SiPMTrayCache.hpp"
+#include "SiPMTraySchema.hpp"
+#include "SiPMDataManifest.hpp"
+#include "SiPMParseDiagnostics.hpp"
+#include "SiPMTrayArchive.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 
 // Compiler flag to read with modified SPS format
 //#define read_modified_SPS_format
@@ -21,58 +33,236 @@ SiPMDataReader* gReader = NULL;
 
 //========================================================================== Storage Format Structs
 
+// Parameter set row of IV_result.txt (its first line): when the tray was measured and
+// the stand settings used, e.g.
+//   250821-1302 250821-1302_0_0 1759879447 50 1.000 0.000 5.000 0.000 7.000 ...
+// The settings are kept as written, in file order, so trays can be grouped by stand configuration.
+// Plain data: it is stored byte for byte in the tray cache.
+struct IV_parameter_set {
+  static const int kMaxSettings = 24;
+  
+  bool    valid;                    // false if the row was missing or unreadable
+  int64_t timestamp;                // Start of the IV measurement [Unix time, s]
+  int     n_settings;
+  float   settings[kMaxSettings];   // Values after the timestamp
+  
+  IV_parameter_set() {Reset();}
+  
+  void Reset() {
+    valid = false;
+    timestamp = -999;
+    n_settings = 0;
+    for (int i = 0; i < kMaxSettings; ++i) settings[i] = -999;
+  }
+  
+  // Read TRAYID+NOTE, SIPMID, TIMESTAMP, SETTINGS... from one line
+  bool Parse(const char* cursor, const char* line_end) {
+    const char *tok_begin, *tok_end;
+    Reset();
+    if (!nextToken(cursor, line_end, tok_begin, tok_end)) return false;  // TRAYID+NOTE
+    if (!nextToken(cursor, line_end, tok_begin, tok_end)) return false;  // SIPMID
+    if (!nextToken(cursor, line_end, tok_begin, tok_end) || !tokenToInt(tok_begin, tok_end, timestamp)) {
+      timestamp = -999;
+      return false;
+    }
+    while (n_settings < kMaxSettings && nextToken(cursor, line_end, tok_begin, tok_end)) {
+      if (!tokenToFloat(tok_begin, tok_end, settings[n_settings])) return false;
+      ++n_settings;
+    }
+    valid = true;
+    return true;
+  }
+  
+  // Same stand configuration (timestamps aside)?
+  bool SameSettings(const IV_parameter_set& other) const {
+    if (!valid || !other.valid || n_settings != other.n_settings) return false;
+    for (int i = 0; i < n_settings; ++i) if (settings[i] != other.settings[i]) return false;
+    return true;
+  }
+};// structdef :: IV_parameter_set
+
+
+
 // Results of IV measurement for a full tray
+// Every quantity is a NROW*NCOL column in one contiguous block (see SiPMTrayBlock.hpp)
 struct IV_data {
-  // SiPM tray row/index identifiers
+  // Column slots in the tray block (int columns first)
+  enum Column {kRow, kCol, kAvgTemp, kStdevTemp, kVpeak, kVpeak25C,
+               kIdark3below, kIdark4above, kIdarkTemp, kForwardRes, kNColumns};
+  static const int kNIntColumns = 2;
+  
   std::string tray_note;
-  std::vector<int>* row;
-  std::vector<int>* col;
+  IV_parameter_set parameters;   // From the first line of IV_result.txt
+  TrayBlock block;
+  
+  // SiPM tray row/index identifiers
+  TrayColumn<int> row;
+  TrayColumn<int> col;
   
   // Temperature data
-  std::vector<float>* avg_temp;
-  std::vector<float>* stdev_temp;
+  TrayColumn<float> avg_temp;
+  TrayColumn<float> stdev_temp;
   
   // IV V_peak measurement
-  std::vector<float>* IV_Vpeak;
-  std::vector<float>* IV_Vpeak_25C;
+  TrayColumn<float> IV_Vpeak;
+  TrayColumn<float> IV_Vpeak_25C;
   
   // Dark current measurement
-  std::vector<float>* Idark_3below;
-  std::vector<float>* Idark_4above;
-  std::vector<float>* Idark_temp;
+  TrayColumn<float> Idark_3below;
+  TrayColumn<float> Idark_4above;
+  TrayColumn<float> Idark_temp;
   
   // Forward resistance measurement
-  std::vector<float>* forward_res;
+  TrayColumn<float> forward_res;
+  
+  // All columns start at -999 (failed measurement or missing SiPM) and invalid
+  IV_data() : block(kNIntColumns, kNColumns - kNIntColumns) {
+    row           = TrayColumn<int>(block.IntColumn(kRow), block.Mask(kRow));
+    col           = TrayColumn<int>(block.IntColumn(kCol), block.Mask(kCol));
+    avg_temp      = TrayColumn<float>(block.FloatColumn(kAvgTemp), block.Mask(kAvgTemp));
+    stdev_temp    = TrayColumn<float>(block.FloatColumn(kStdevTemp), block.Mask(kStdevTemp));
+    IV_Vpeak      = TrayColumn<float>(block.FloatColumn(kVpeak), block.Mask(kVpeak));
+    IV_Vpeak_25C  = TrayColumn<float>(block.FloatColumn(kVpeak25C), block.Mask(kVpeak25C));
+    Idark_3below  = TrayColumn<float>(block.FloatColumn(kIdark3below), block.Mask(kIdark3below));
+    Idark_4above  = TrayColumn<float>(block.FloatColumn(kIdark4above), block.Mask(kIdark4above));
+    Idark_temp    = TrayColumn<float>(block.FloatColumn(kIdarkTemp), block.Mask(kIdarkTemp));
+    forward_res   = TrayColumn<float>(block.FloatColumn(kForwardRes), block.Mask(kForwardRes));
+  }
 };// structdef :: IV_data
 
 
 
 // Results of SPS measurement for a full tray
+// Every quantity is a NROW*NCOL column in one contiguous block (see SiPMTrayBlock.hpp)
 struct SPS_data {
-  // SiPM tray row/index identifiers
+  // Column slots in the tray block (int columns first)
+  enum Column {kRow, kCol, kNpeaks, kAvgTemp, kStdevTemp, kPeakwidth, kVbd, kVbd25C,
+               kVbdUnc, kChi2ndf, kFitParm0, kFitParm1, kSteepnessUnc, kGain, kNColumns};
+  static const int kNIntColumns = 3;
+  
   std::string tray_note;
-  std::vector<int>* row;
-  std::vector<int>* col;
+  TrayBlock block;
+  
+  // SiPM tray row/index identifiers
+  TrayColumn<int> row;
+  TrayColumn<int> col;
   
   // Temperature data
-  std::vector<float>* avg_temp;
-  std::vector<float>* stdev_temp;
+  TrayColumn<float> avg_temp;
+  TrayColumn<float> stdev_temp;
   
   // SPS spectrum info
-  std::vector<int>* SPS_npeaks;
-  std::vector<float>* SPS_peakwidth;
+  TrayColumn<int> SPS_npeaks;
+  TrayColumn<float> SPS_peakwidth;
   
   // SPS V_breakdown measurement
-  std::vector<float>* SPS_Vbd;
-  std::vector<float>* SPS_Vbd_25C;
-  std::vector<float>* SPS_Vbd_unc;
-  std::vector<float>* SPS_chi2ndf;
+  TrayColumn<float> SPS_Vbd;
+  TrayColumn<float> SPS_Vbd_25C;
+  TrayColumn<float> SPS_Vbd_unc;
+  TrayColumn<float> SPS_chi2ndf;
   
   // SPS fit parameters P0, P1
-  std::vector<float>* fit_parm_0;
-  std::vector<float>* fit_parm_1;
+  TrayColumn<float> fit_parm_0;
+  TrayColumn<float> fit_parm_1;   // Also the "Steepness" of SPS_result.txt
+  
+  // Only in the verbose SPS_result.txt (see SiPMDataReader::SetReadVerboseSPS)
+  TrayColumn<float> SPS_steepness_unc;
+  TrayColumn<float> SPS_gain;     // Gain @ Vbd(25C) + 5V
+  
+  // All columns start at -999 (failed measurement or missing SiPM) and invalid
+  SPS_data() : block(kNIntColumns, kNColumns - kNIntColumns) {
+    row           = TrayColumn<int>(block.IntColumn(kRow), block.Mask(kRow));
+    col           = TrayColumn<int>(block.IntColumn(kCol), block.Mask(kCol));
+    SPS_npeaks    = TrayColumn<int>(block.IntColumn(kNpeaks), block.Mask(kNpeaks));
+    avg_temp      = TrayColumn<float>(block.FloatColumn(kAvgTemp), block.Mask(kAvgTemp));
+    stdev_temp    = TrayColumn<float>(block.FloatColumn(kStdevTemp), block.Mask(kStdevTemp));
+    SPS_peakwidth = TrayColumn<float>(block.FloatColumn(kPeakwidth), block.Mask(kPeakwidth));
+    SPS_Vbd       = TrayColumn<float>(block.FloatColumn(kVbd), block.Mask(kVbd));
+    SPS_Vbd_25C   = TrayColumn<float>(block.FloatColumn(kVbd25C), block.Mask(kVbd25C));
+    SPS_Vbd_unc   = TrayColumn<float>(block.FloatColumn(kVbdUnc), block.Mask(kVbdUnc));
+    SPS_chi2ndf   = TrayColumn<float>(block.FloatColumn(kChi2ndf), block.Mask(kChi2ndf));
+    fit_parm_0    = TrayColumn<float>(block.FloatColumn(kFitParm0), block.Mask(kFitParm0));
+    fit_parm_1    = TrayColumn<float>(block.FloatColumn(kFitParm1), block.Mask(kFitParm1));
+    SPS_steepness_unc = TrayColumn<float>(block.FloatColumn(kSteepnessUnc), block.Mask(kSteepnessUnc));
+    SPS_gain      = TrayColumn<float>(block.FloatColumn(kGain), block.Mask(kGain));
+  }
 };// structdef :: SPS_data
 
+//========================================================================== Text Formats
+
+// Layouts of the result files as written by the test stands (see SiPMTraySchema.hpp)
+// Field lists follow data/IV_HEADERS.txt and data/SPS_HEADERS.txt in column order.
+
+// IV_result.txt
+// TRAYID+NOTE, SIPMID, AVERAGE_TEMPERATURE, TEMPERATURE_DEVIATION, RAW_VPEAK, VPEAK(25C), IDARK(-3V)[nA], IDARK(+4V)[nA], TEMERATURE_BEFORE_IDARK_MEASUREMENT, FORWARD_RESISTANCE
+struct IV_format {
+  typedef IV_data Data;
+  static constexpr bool     has_header_line = true;
+  static constexpr bool     leading_note_token = true;
+  static constexpr int      n_id_trailing_fields = 0;
+  static constexpr uint32_t cache_layout = 1;
+  typedef FieldList<
+    Field<IV_data::kAvgTemp,     float>,                    // AVERAGE_TEMPERATURE[C]
+    Field<IV_data::kStdevTemp,   float>,                    // TEMPERATURE_DEVIATION[C]
+    Field<IV_data::kVpeak,       float, kFieldStopOnNaN>,   // RAW_VPEAK[V] (nan for a failed measurement in the new output format)
+    Field<IV_data::kVpeak25C,    float>,                    // VPEAK(25C)[V]
+    Field<IV_data::kIdark3below, float>,                    // IDARK(-3V)[nA]
+    Field<IV_data::kIdark4above, float>,                    // IDARK(+4V)[nA]
+    Field<IV_data::kIdarkTemp,   float>,                    // TEMERATURE_BEFORE_IDARK_MEASUREMENT
+    Field<IV_data::kForwardRes,  float>                     // FORWARD_RESISTANCE[Ω] (TODO CHECK THIS IS THE RIGHT UNITS)
+  > Fields;
+  
+  // First line: the parameter set
+  static bool ParseHeader(const char* line, const char* line_end, IV_data& data) {return data.parameters.Parse(line, line_end);}
+};// structdef :: IV_format
+
+// SPS_result_onlynumbers.txt
+// SIPMID, USED_PEAKS, FIT_WIDTH, ROW_VBD, AVERAGE_TEMPERATURE, TEMPERATURE_UNCERAINITY, VBD(25C), VBD_UNCERAINITY, chi2ndf, p0mean, p1mean
+// The tray note is the part of SIPMID before the SiPM indices.
+struct SPS_format {
+  typedef SPS_data Data;
+  static constexpr bool     has_header_line = false;
+  static constexpr bool     leading_note_token = false;
+  static constexpr int      n_id_trailing_fields = 0;
+  static constexpr uint32_t cache_layout = 2;
+  typedef FieldList<
+    Field<SPS_data::kNpeaks,     int>,      // USED_PEAKS[NUMBER OF PEAKS FIT IN SPS]
+    Field<SPS_data::kPeakwidth,  float>,    // FIT_WIDTH[SPS PEAK WIDTH ASSUMED BY FITTER]
+    Field<SPS_data::kVbd,        float>,    // ROW_VBD[V] (AT MEASURED TEMPERATURE)
+    Field<SPS_data::kAvgTemp,    float>,    // AVERAGE_TEMPERATURE[C]
+    Field<SPS_data::kStdevTemp,  float>,    // TEMPERATURE_UNCERAINITY[C]
+    Field<SPS_data::kVbd25C,     float>,    // VBD(25C)[V]
+    Field<SPS_data::kVbdUnc,     float>,    // VBD_UNCERAINITY[V] (MONTE CARLO ERROR ESTIMATION PROCEDURE)
+    Field<SPS_data::kChi2ndf,    float>,    // CHI^2/NDF[LINEAR SPS GAIN FIT QUALITY]
+    Field<SPS_data::kFitParm0,   float>,    // p0mean[AVG p0 AMONG SPS PEAKS]
+    Field<SPS_data::kFitParm1,   float>     // p1mean[AVG p1 AMONG SPS PEAKS]
+  > Fields;
+};// structdef :: SPS_format
+
+// SPS_result_onlynumbers.txt from the robot stand: two extra underscore fields after the SiPM indices
+struct SPS_robot_format : SPS_format {
+  static constexpr int      n_id_trailing_fields = 2;
+  static constexpr uint32_t cache_layout = 3;
+};// structdef :: SPS_robot_format
+
+// Where a SiPM sits in the loaded data (see SiPMDataReader::FindSiPM)
+struct SiPMLocation {
+  int tray_index;        // Slot in the tray list, -1 if not found
+  int flattened_index;   // row*NCOL + col within the tray's columns
+  
+  bool IsValid() const {return tray_index >= 0;}
+};// structdef :: SiPMLocation
+
+// Tray list entries of one test batch: tray IDs sharing the part before the '-',
+// e.g. batch "250821" holds 250821-1301 ... 250821-1305 (see SiPMDataReader::GetBatch)
+struct TrayBatch {
+  std::string      label;
+  std::vector<int> trays;         // Tray list slots, in list order
+  std::vector<int> tray_numbers;  // Number after the '-' of each tray (1301), -1 if there is none
+  int              n_cassette;    // Entries per mode
+  int              n_robot;
+};// structdef :: TrayBatch
+
 //========================================================================== SiPMDataReader class
 
 class SiPMDataReader {
@@ -80,41 +270,73 @@ private:
   // *---------------- Class variables
   
   // Primary input file to read strings of trays to use in analysis
-  std::string* batch_data_file;
-  std::string* batch_data_dir;
+  std::string batch_data_file;
+  std::string batch_data_dir;
   
   // Strings for Hamamatsu Tray numbers to access from directories
-  std::vector<std::string>* tray_strings;
-  std::vector<int>* tray_modes;
+  std::vector<std::string> tray_strings;
+  std::vector<int> tray_modes;
   // Valid modes :: of Data
   //   0 - Cassette setup
   //   1 - Robotic setup
   // Can add more if desired
   
+  // Index of result directories in the data directory, rebuilt each time a tray list is read
+  TrayManifest manifest;
+  
+  // Batch archive the trays are read from instead of the data directory (see SetArchive)
+  TrayArchive archive;
+  
+  // Hash index of the tray list: tray ID -> slot, one map per mode.
+  // Kept in step with tray_strings/tray_modes by IndexTrays.
+  std::vector<std::unordered_map<std::string, int> > tray_index;
+  
+  // Batch index of the tray list: batch label -> slot in batches, also kept in step by IndexTrays
+  std::vector<TrayBatch>               batches;
+  std::unordered_map<std::string, int> batch_index;
+  
+  // Lines skipped (or only partly read) while parsing, per file; cleared by ReadFile
+  ParseDiagnostics diagnostics;
+  
   // Data arrays in struct format
-  std::vector<struct IV_data*>* IV_internal;
-  std::vector<struct SPS_data*>* SPS_internal;
+  // The reader owns the per-tray structs; they are freed on every reload (ClearIV/ClearSPS) and on destruction
+  std::vector<struct IV_data*> IV_internal;
+  std::vector<struct SPS_data*> SPS_internal;
+  bool has_IV_data;   // ReadDataIV has been run for the current tray list
+  bool has_SPS_data;  // ReadDataSPS has been run for the current tray list
+  uint64_t data_generation;  // New value whenever IV/SPS data is loaded or freed (see GetDataGeneration)
   
   // Flags for systematic analysis
   bool read_for_systematics; // TODO implement flags in reader
   bool has_subscript_results; // production data ends in "-results", systematics often don't.
   bool modified_SPS_output_format; // 2 extra columns in SPS name label, needed to properly index SiPMs.
+  bool read_verbose_SPS; // Also read steepness uncertainty and gain from SPS_result.txt
   
   // flags for printing and debugging
   bool verbose_mode;           // Print a reasonable amount of info about processes as they occur
   bool print_IV_all_SiPMs;     // Print detailed IV test information for each SiPM in the batch list--large output
   bool print_SPS_all_SiPMs;    // Print detailed SPS test information for each SiPM in the batch list--large output
   
+  // Number of worker threads used to parse trays in ReadDataIV/ReadDataSPS (1: serial)
+  int n_threads;
+  
+  // Use binary caches next to the text result files (see SiPMTrayCache.hpp)
+  bool use_tray_cache;
+  
   // *---------------- Internal Helper Methods (Main I/O Handlers)
   
   // Read batch tray indices from text file
   // This specifies which trays are to be inspected in the current batch
-  void GetBatchStrings() {
+  //
+  // With append_only_new, the current tray list is kept as it is: trays already
+  // in it are skipped, and only the remaining ones are validated and appended.
+  void GetBatchStrings(bool append_only_new = false) {
     
     // Print about the input file
-    if (verbose_mode) std::cout << "Reading intput file " << t_blu << *batch_data_file << t_def << " for Tray batch numbers...";
-    std::ifstream infile(batch_data_file->c_str());
+    if (verbose_mode) std::cout << "Reading intput file " << t_blu << batch_data_file << t_def << " for Tray batch numbers...";
+    std::ifstream infile(batch_data_file.c_str());
     std::string cline;
+    std::vector<std::string> requested_trays;
     
     // Read specified file...
     bool flag_start = false;
@@ -134,13 +356,21 @@ private:
       }
       
       // Append new tray string to list
-      this->tray_strings->push_back(cline);
+      // Trays already loaded with both cassette and robot data cannot add anything when appending
+      if (append_only_new && HasTrayEntry(cline, 0) && HasTrayEntry(cline, 1)) continue;
+      requested_trays.push_back(cline);
     }// End of file read
     
+    // Nothing new to add is not an error when appending
+    if (append_only_new && requested_trays.empty()) {
+      if (verbose_mode) std::cout << "No new trays." << std::endl;
+      return;
+    }
+    
     // Check that SiPMs were found in the file
-    if (this->tray_strings->empty()) {
-      std::cout << t_red << "Failed!" << t_def << " Check file " << *batch_data_file << "." << std::endl;
-      std::cout << t_red << "Failed!" << t_def << " Check file " << *batch_data_file << "." << std::endl;
+    if (requested_trays.empty()) {
+      std::cout << t_red << "Failed!" << t_def << " Check file " << batch_data_file << "." << std::endl;
+      std::cout << t_red << "Failed!" << t_def << " Check file " << batch_data_file << "." << std::endl;
       std::cerr << "Failed to read file for SiPM tray numbers. Exiting..." << std::endl;
       return;
     }
@@ -156,17 +386,34 @@ private:
       std::cout << "   - " << t_red << "Red" << t_def << "  : Invalid/Failed to read" << std::endl;
     }
     
+    AddTrays(requested_trays, append_only_new);
+    return;
+  }// End of SiPMDataReader::GetBatchStrings
+  
+  
+  
+  // Validate the requested trays and assign the valid (tray, mode) entries to the tray list
+  // With append_only_new, entries already in the list are dropped and the rest are appended
+  // after the existing ones, so earlier indices do not change.
+  void AddTrays(const std::vector<std::string>& requested_trays, bool append_only_new) {
     
     // Check that directories are valid
-    std::vector<std::string>* valid_trays = new std::vector<std::string>();
-    std::vector<int>*         valid_modes = new std::vector<int>();
-    std::vector<std::string>* invalid_trays = new std::vector<std::string>();
+    // When appending, only the new trays' directories need to be (re)listed
+    if (append_only_new && !this->archive.IsOpen() && this->manifest.GetDataDir() == GetDataDirectory()) {
+      for (std::vector<std::string>::const_iterator it = requested_trays.begin(); it != requested_trays.end(); ++it) {
+        this->manifest.Refresh(TrayManifest::DirectoryName(*it, false, this->has_subscript_results));
+        this->manifest.Refresh(TrayManifest::DirectoryName(*it, true, this->has_subscript_results));
+      }
+    } else BuildManifest();
+    std::vector<std::string> valid_trays;
+    std::vector<int>         valid_modes;
+    std::vector<std::string> invalid_trays;
     if (verbose_mode)std::cout << "Checking tray data..." << std::endl;
     
     
     // Check tray data
     if (verbose_mode) std::cout << "SiPM Trays in Batch: {";
-    for (std::vector<std::string>::iterator it = this->tray_strings->begin(); it != this->tray_strings->end(); ++it) {
+    for (std::vector<std::string>::const_iterator it = requested_trays.begin(); it != requested_trays.end(); ++it) {
       // Check validity of current tray
       bool is_valid_cassette = CheckValidTray(*it, false);
       bool is_valid_robot = CheckValidTray(*it, true);
@@ -177,27 +424,27 @@ private:
         else if (is_valid_cassette)                std::cout << t_grn;
         else if (is_valid_robot)                   std::cout << t_cyn;
         std::cout << *it << t_def;
-        if (it + 1 != this->tray_strings->end()) std::cout << ", ";
+        if (it + 1 != requested_trays.end()) std::cout << ", ";
       }
       
       // Append to valid/invalid
       // Note that a tray may have valid robot data and valid non-robot data!
-      if (is_valid_cassette) {
-        valid_trays->push_back(*it);
-        valid_modes->push_back(0);
-      } if (is_valid_robot) {
-        valid_trays->push_back(*it);
-        valid_modes->push_back(1);
-      } if (!is_valid_cassette && !is_valid_robot) invalid_trays->push_back(*it); // Only invalid if fails for both
+      if (is_valid_cassette && !(append_only_new && HasTrayEntry(*it, 0))) {
+        valid_trays.push_back(*it);
+        valid_modes.push_back(0);
+      } if (is_valid_robot && !(append_only_new && HasTrayEntry(*it, 1))) {
+        valid_trays.push_back(*it);
+        valid_modes.push_back(1);
+      } if (!is_valid_cassette && !is_valid_robot) invalid_trays.push_back(*it); // Only invalid if fails for both
     }if (verbose_mode) std::cout << '}' << std::endl;
     
-    if (!invalid_trays->empty()) {
+    if (!invalid_trays.empty()) {
       
       // If invalid trays found, report on which ones are invalid
       std::cout << t_red << "Warning " << t_def << ":: Trays {";
-      for (std::vector<std::string>::iterator it = invalid_trays->begin(); it != invalid_trays->end(); ++it) {
+      for (std::vector<std::string>::iterator it = invalid_trays.begin(); it != invalid_trays.end(); ++it) {
         std::cout << t_red << *it << t_def;
-        if (it + 1 != invalid_trays->end()) std::cout << ", ";
+        if (it + 1 != invalid_trays.end()) std::cout << ", ";
       } std::cout << "} do not exist or do not have the necessary files." << std::endl << std::endl;
       std::cout << "Note that each directory should be named [" << t_blu << "TRAY_INDEX" << t_def << "-results]," << std::endl;
       std::cout << "and should contain files {" << t_blu << "IV_result.txt" << t_def << ", ";
@@ -216,81 +463,358 @@ private:
         std::cout << "If this is not desired, enable the flag by setting SiPMDataReader::SetDefTrayString()" << std::endl;
       }// End of error print
       
-      if (valid_trays->empty()) {
-        std::cerr << t_red << "No valid trays. Terminating..." << t_def << std::endl;
+      if (valid_trays.empty()) {
+        if (append_only_new) std::cerr << t_red << "No new valid trays to append." << t_def << std::endl;
+        else                 std::cerr << t_red << "No valid trays. Terminating..." << t_def << std::endl;
         return;
       }
       
       std::cout << "The code will run with only trays {";
-      for (std::vector<std::string>::iterator it = tray_strings->begin(); it != tray_strings->end(); ++it) {
+      for (std::vector<std::string>::const_iterator it = requested_trays.begin(); it != requested_trays.end(); ++it) {
         std::cout << t_grn << *it << t_def;
-        if (it + 1 != tray_strings->end()) std::cout << ", ";
+        if (it + 1 != requested_trays.end()) std::cout << ", ";
       }std::cout << "}." << std::endl;
     } else if (verbose_mode) std::cout << "All trays valid. Continuing to analysis..." << std::endl;
     
-    // Valid trays assigned
-    this->tray_strings = valid_trays;
-    this->tray_modes = valid_modes;
-    delete invalid_trays;
+    // Valid trays assigned (appended after the existing ones, so their indices do not change)
+    int first_new = this->tray_strings.size();
+    if (append_only_new) {
+      this->tray_strings.insert(this->tray_strings.end(), valid_trays.begin(), valid_trays.end());
+      this->tray_modes.insert(this->tray_modes.end(), valid_modes.begin(), valid_modes.end());
+    } else {
+      this->tray_strings.swap(valid_trays);
+      this->tray_modes.swap(valid_modes);
+      ClearTrayIndex();
+      first_new = 0;
+    }
+    IndexTrays(first_new);
     return;
-  }// End of SiPMDataReader::GetBatchStrings
+  }// End of SiPMDataReader::AddTrays
+  
+  
+  
+  // Add the tray list entries from first_tray on to the hash and batch indices
+  void IndexTrays(int first_tray) {
+    for (int i = first_tray; i < tray_strings.size(); ++i) {
+      int mode = tray_modes.at(i);
+      if (mode >= tray_index.size()) tray_index.resize(mode + 1);
+      tray_index[mode].emplace(tray_strings.at(i), i);
+      
+      // Batch of the tray, created on its first tray
+      const std::string& tray = tray_strings.at(i);
+      std::pair<std::unordered_map<std::string, int>::iterator, bool> slot = batch_index.emplace(BatchLabel(tray), batches.size());
+      if (slot.second) {
+        TrayBatch batch;
+        batch.label = slot.first->first;
+        batch.n_cassette = 0;
+        batch.n_robot = 0;
+        batches.push_back(batch);
+      }
+      TrayBatch& batch = batches[slot.first->second];
+      size_t dash = tray.find('-');
+      int number = -1;
+      if (dash != std::string::npos && !tokenToInt(tray.data() + dash + 1, tray.data() + tray.size(), number)) number = -1;
+      batch.trays.push_back(i);
+      batch.tray_numbers.push_back(number);
+      if (mode == 1) ++batch.n_robot;
+      else           ++batch.n_cassette;
+    }
+  }
+  
+  void ClearTrayIndex() {
+    this->tray_index.clear();
+    this->batches.clear();
+    this->batch_index.clear();
+  }
+  
+  // Is this tray already in the tray list with the given mode (0 cassette, 1 robot)?
+  bool HasTrayEntry(const std::string& tray, int mode) {return FindTray(tray, mode) >= 0;}
+  
+  
+  
+  // Free all per-tray IV/SPS data and mark it as not read
+  void ClearIV() {
+    for (int i = 0; i < IV_internal.size(); ++i) delete IV_internal[i];
+    IV_internal.clear();
+    this->has_IV_data = false;
+    this->data_generation = NextDataGeneration();
+  }
+  void ClearSPS() {
+    for (int i = 0; i < SPS_internal.size(); ++i) delete SPS_internal[i];
+    SPS_internal.clear();
+    this->has_SPS_data = false;
+    this->data_generation = NextDataGeneration();
+  }
+  
+  // Generations are unique across all readers, so a cache keyed on one cannot mistake another reader's data
+  static uint64_t NextDataGeneration() {
+    static std::atomic<uint64_t> last_generation(0);
+    return ++last_generation;
+  }
+  
+  // One line warning when a read added parse issues (details via PrintDiagnostics)
+  void WarnParseIssues(const char* data_type, int n_issues_before) {
+    int n_new = this->diagnostics.GetNIssues() - n_issues_before;
+    if (n_new <= 0) return;
+    std::cout << t_red << "Warning" << t_def << " in <SiPMDataReader::ReadData" << data_type << ">: " << t_red << n_new << t_def;
+    std::cout << " line(s) skipped or incomplete, see PrintDiagnostics()." << std::endl;
+  }
+  
+  // Not copyable: owns the per-tray data
+  SiPMDataReader(const SiPMDataReader&);
+  SiPMDataReader& operator=(const SiPMDataReader&);
+  
+  
+  
+  // Parse the IV/SPS data of the entries appended from first_tray on,
+  // for whichever data types have already been read for the earlier entries
+  void ReadAppendedTrays(int first_tray) {
+    int n_new = this->tray_strings.size() - first_tray;
+    if (n_new <= 0) return;
+    if (this->has_IV_data) {
+      if (verbose_mode) std::cout << "Gathering IV data for " << t_mgn << n_new << t_def << " appended trays." << std::endl;
+      ReadTraysIV(first_tray);
+    }
+    if (this->has_SPS_data) {
+      if (verbose_mode) std::cout << "Gathering SPS data for " << t_mgn << n_new << t_def << " appended trays." << std::endl;
+      ReadTraysSPS(first_tray);
+    }
+  }// End of SiPMDataReader::ReadAppendedTrays
   
   
   
   // Check that a given tray is valid (i.e. its directory exists and has the right files)
+  // Answered from the directory manifest built by GetBatchStrings--no filesystem access.
+  // Each directory should have IV_result.txt and SPS_result_onlynumbers.txt;
+  // SPS_result.txt is not necessary but we will continue to keep it there in case we find a use for it.
   bool CheckValidTray(std::string tray, bool check_for_robot_dir = false) {
-    // get the data directory based on the current flags
-    char dir[75];
-    if (this->batch_data_dir->size() == 0) {    // No subdirectory
-      if (!check_for_robot_dir) {               // Not checking for robot data
-        if (this->has_subscript_results) snprintf(dir, 75, "../data/%s-results", tray.c_str());
-        else                             snprintf(dir, 75, "../data/%s", tray.c_str());
-      } else {                                  // Checking for robot data
-        if (this->has_subscript_results) snprintf(dir, 75, "../data/%s-robot-results", tray.c_str());
-        else                             snprintf(dir, 75, "../data/%s-robot", tray.c_str());
-      }
-    } else {                                    // Has subdirectory
-      if (!check_for_robot_dir) {               // Not checking for robot data
-        if (this->has_subscript_results) snprintf(dir, 75, "../data/%s/%s-results", batch_data_dir->c_str(), tray.c_str());
-        else                             snprintf(dir, 75, "../data/%s/%s", batch_data_dir->c_str(), tray.c_str());
-      } else {                                  // Checking for robot data
-        if (this->has_subscript_results) snprintf(dir, 75, "../data/%s/%s-robot-results", batch_data_dir->c_str(), tray.c_str());
-        else                             snprintf(dir, 75, "../data/%s/%s-robot", batch_data_dir->c_str(), tray.c_str());
-      }
-    }// End of possible directory tree
+    TrayLocation location = this->manifest.Lookup(tray, this->has_subscript_results);
+    if (check_for_robot_dir) return location.HasRobot();
+    return location.HasCassette();
+  }// End of SiPMDataReader::CheckValidTray
+  
+  // Index the result directories of the current data directory (one listing instead of stat() per tray)
+  void BuildManifest() {
+    if (this->archive.IsOpen()) this->archive.FillManifest(this->manifest);
+    else if (!this->manifest.Scan(GetDataDirectory())) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMDataReader::BuildManifest>: could not list " << GetDataDirectory() << std::endl;
+    } else if (verbose_mode) {
+      std::cout << "Indexed " << t_mgn << this->manifest.GetNDirectories() << t_def << " directories in " << t_blu << GetDataDirectory() << t_def << std::endl;
+    }
+  }// End of SiPMDataReader::BuildManifest
+
+
+
+  // Parse a single tray's result file, laid out as Format, into a new data struct
+  // The file is memory mapped and tokenized in place--no per-line strings are built.
+  // Missing SiPMs and failed measurements are left as -999; unusable lines are recorded in diagnostics.
+  template <class Format>
+  typename Format::Data* ReadTray(const char* filename, const std::string& tray, bool print_all_SiPMs) {
+    typedef typename Format::Data Data;
     
-    // Files which each directory should have:
-    const int num_subfiles = 2;
-    const char filelist[num_subfiles][50] = {
-      "IV_result.txt",
-      "SPS_result_onlynumbers.txt"
-      //"SPS_result.txt" /* File is not necessary but we will continue to keep it there in case we find a use for it */
-    };
+    // -999: failed measurement or missing SiPM (set by the data constructor)
+    Data* current_data = new Data();
     
-    // Use the stat struct to check the directory exists
-    struct stat check_dir;
-    if (stat(dir, &check_dir) == 0) {
-      // Directory OK, check files:
-      for (int i_file = 0; i_file < num_subfiles; ++i_file) {
-        
-        // Get current subfile
-        char subfile[100];
-        snprintf(subfile, 100, "%s/%s",dir,filelist[i_file]);
-        
-        struct stat check_file;
-        if (stat(subfile, &check_file) == 0 && !(check_file.st_mode & S_IFDIR)) continue;
-        else goto failed;
-      }
-      
-      // Found all result files.
+    // Load from the binary cache if the text file has not changed since it was written
+    // The format changes the parsed indices, so its layout tag is part of the cache key
+    TrayCacheColumns cache_columns = CacheColumns(current_data);
+    TrayCacheHeader cache_key = TrayCacheHeader();
+    bool use_cache = this->use_tray_cache && !print_all_SiPMs && !this->archive.IsOpen(); // Archive members are never cached
+    if (use_cache && loadTrayCache(filename, Format::cache_layout, cache_columns, cache_key)) return current_data;
+    
+    ParseIssueList issues;
+    MappedTextFile infile;
+    const char *text_begin, *text_end;
+    if (!OpenTrayText(filename, infile, text_begin, text_end)) {
+      issues.Add(0, kIssueOpenFailed);
+      this->diagnostics.Add(filename, issues);
+      return current_data;
+    }
+    
+    // Report results of each SiPM if requested
+    if (print_all_SiPMs) {
+      parseTrayText<Format>(text_begin, text_end, current_data, issues, [&](int flattened_index, int crow, int ccol) {
+        PrintSiPM(tray, current_data, flattened_index, crow, ccol);
+      });
+    } else parseTrayText<Format>(text_begin, text_end, current_data, issues, [](int, int, int) {});
+    this->diagnostics.Add(filename, issues);
+    
+    // Mark which entries hold a measurement
+    current_data->block.BuildMasks();
+    
+    // Rebuild the cache for the next load
+    // Files with issues are not cached, so their diagnostics are reported on every load
+    if (use_cache && issues.n_issues == 0) {
+      cache_key.file_size = text_end - text_begin;
+      cache_key.content_hash = hashContent(text_begin, text_end);
+      saveTrayCache(filename, cache_key, cache_columns);
+    }
+    return current_data;
+  }// End of SiPMDataReader::ReadTray
+  
+  // Text of a result file: its archive member when reading from an archive, else the mapped file
+  // Returns false if the file is missing (or empty).
+  bool OpenTrayText(const char* filename, MappedTextFile& infile, const char*& text_begin, const char*& text_end) {
+    if (this->archive.IsOpen()) {
+      const std::string* member = this->archive.GetMember(filename);
+      if (!member || member->empty()) return false;
+      text_begin = member->data();
+      text_end = text_begin + member->size();
       return true;
     }
+    if (!infile.Open(filename)) return false;
+    text_begin = infile.begin();
+    text_end = infile.end();
+    return true;
+  }
+  
+  IV_data* ReadTrayIV(const char* IV_file, const std::string& tray) {
+    return ReadTray<IV_format>(IV_file, tray, print_IV_all_SiPMs);
+  }
+  
+  // The robot stand layout is chosen once per tray, not per line
+  SPS_data* ReadTraySPS(const char* SPS_file, const std::string& tray) {
+    if (this->modified_SPS_output_format) return ReadTray<SPS_robot_format>(SPS_file, tray, print_SPS_all_SiPMs);
+    return ReadTray<SPS_format>(SPS_file, tray, print_SPS_all_SiPMs);
+  }
+  
+  
+  
+  // Per-SiPM printout for SetPrintIV/SetPrintSPS
+  void PrintSiPM(const std::string& tray, IV_data* current_data, int flattened_index, int crow, int ccol) {
+    std::cout << "SiPM " << tray << " (" << t_blu << crow << t_def << ',' << t_blu << ccol << t_def << ") [" << flattened_index << "] :: " << std::endl;
+    std::cout << "Temp " << current_data->avg_temp->at(flattened_index) << "C +/- " << current_data->stdev_temp->at(flattened_index) << "C." << std::endl;
+    std::cout << "V_peak = " << current_data->IV_Vpeak->at(flattened_index) << "V >>> " << t_grn << current_data->IV_Vpeak_25C->at(flattened_index) << t_def << "V @25C. " << std::endl;
+    std::cout << "I_dark = " << current_data->Idark_3below->at(flattened_index) << "nA @(V_op-3), " << current_data->Idark_4above->at(flattened_index) << "nA @(V_op+4)" << std::endl;
+    std::cout << "I_dark measured at " << current_data->Idark_temp->at(flattened_index) << "C, forward resistance = " << current_data->forward_res->at(flattened_index) << " Ohm.\n" << std::endl;
+  }
+  
+  void PrintSiPM(const std::string& tray, SPS_data* current_data, int flattened_index, int crow, int ccol) {
+    std::cout << "SiPM " << tray << " (" << t_blu << crow << t_def << ',' << t_blu << ccol << t_def << ") [" << flattened_index << "] :: " << std::endl;
+    std::cout << "Temp " << current_data->avg_temp->at(flattened_index) << "C +/- " << current_data->stdev_temp->at(flattened_index) << "C." << std::endl;
+    std::cout << "SPS V_bd = " << current_data->SPS_Vbd->at(flattened_index) << "V >>> " << t_grn << current_data->SPS_Vbd_25C->at(flattened_index) << t_def << "V @25C (";
+    std::cout << "+/- " << t_grn << current_data->SPS_Vbd_unc->at(flattened_index) << t_def << ")." << std::endl;
+    std::cout << "SPS Extrapolation fit info :: # of peaks = " << current_data->SPS_npeaks->at(flattened_index) << " using width " << current_data->SPS_peakwidth->at(flattened_index);
+    std::cout << ", chi^2/ndf = " << current_data->SPS_chi2ndf->at(flattened_index) << "." << std::endl;
+    std::cout << "Fit parm means :: p0 = " << current_data->fit_parm_0->at(flattened_index) << ", p1 = " << current_data->fit_parm_1->at(flattened_index) << std::endl << std::endl;
+  }
+
+
+
+  // Fill the steepness uncertainty and gain of a tray from its verbose SPS_result.txt.
+  // The file has one block of "Label: value" lines per SiPM, e.g.
+  //   SiPM ID: 250821-1301_0_0
+  //   Steepness: 92.865 +/- 0.491
+  //   Gain @ Vbd(25C) + 5V: 469.529
+  // Values are assigned to the SiPM of the last "SiPM ID" line, so the block length and line
+  // order do not matter. SiPMs missing from the file (or a missing file) stay at -999.
+  void ReadTraySPSVerbose(const char* SPS_verbose_file, SPS_data* data) {
+    ParseIssueList issues;
+    MappedTextFile infile;
+    const char *cursor, *file_end;
+    if (!OpenTrayText(SPS_verbose_file, infile, cursor, file_end)) {
+      issues.Add(0, kIssueOpenFailed);
+      this->diagnostics.Add(SPS_verbose_file, issues);
+      return;
+    }
     
-    // Either failed to find directory or result files
-  failed:
-    return false;
-  }// End of SiPMDataReader::CheckValidTray
+    // SiPM IDs carry the same extra fields as in SPS_result_onlynumbers.txt
+    int n_trailing_fields = this->modified_SPS_output_format ? SPS_robot_format::n_id_trailing_fields : SPS_format::n_id_trailing_fields;
+    
+    int flattened_index = -1;
+    int line_number = 0;
+    while (cursor < file_end) {
+      const char* line = cursor;
+      const char* line_end = nextLine(cursor, file_end);
+      const char *tok_begin, *tok_end;
+      float value;
+      ++line_number;
+      
+      // Other labels are not used; only unreadable SiPM IDs are reported
+      if (skipPrefix(line, line_end, "SiPM ID:")) {
+        int ccol, crow;
+        flattened_index = -1;
+        if (!nextToken(line, line_end, tok_begin, tok_end)) {issues.Add(line_number, kIssueBadSiPMID); continue;}
+        if (!splitSiPMIndex(tok_begin, tok_end, n_trailing_fields, ccol, crow)) {
+          issues.Add(line_number, kIssueBadSiPMID, -1, tok_begin, tok_end);
+          continue;
+        }
+        if (crow < 0 || ccol < 0 || crow >= NROW || ccol >= NCOL) {
+          issues.Add(line_number, kIssueIndexOutOfRange, -1, tok_begin, tok_end);
+          continue;
+        }
+        flattened_index = crow*NCOL + ccol;
+      } else if (flattened_index < 0) continue;
+      else if (skipPrefix(line, line_end, "Steepness:")) {
+        // value +/- error: the value itself is fit_parm_1
+        if (!nextToken(line, line_end, tok_begin, tok_end)) continue;
+        if (!nextToken(line, line_end, tok_begin, tok_end)) continue; // "+/-"
+        if (nextToken(line, line_end, tok_begin, tok_end) && tokenToFloat(tok_begin, tok_end, value)) data->SPS_steepness_unc[flattened_index] = value;
+      } else if (skipPrefix(line, line_end, "Gain @ Vbd(25C) + 5V:")) {
+        if (nextToken(line, line_end, tok_begin, tok_end) && tokenToFloat(tok_begin, tok_end, value)) data->SPS_gain[flattened_index] = value;
+      }
+    }// End of processing current line
+    this->diagnostics.Add(SPS_verbose_file, issues);
+    
+    data->block.BuildMask(SPS_data::kSteepnessUnc);
+    data->block.BuildMask(SPS_data::kGain);
+  }// End of SiPMDataReader::ReadTraySPSVerbose
+
+
+
+  // Cache payload of a tray: its note, IV parameter set and the raw tray block (see SiPMTrayCache.hpp)
+  // Changing the column slots of IV_data/SPS_data or IV_parameter_set requires bumping tray_cache_version
+  TrayCacheColumns CacheColumns(IV_data* data) {
+    TrayCacheColumns columns = {&data->tray_note, &data->block, reinterpret_cast<char*>(&data->parameters), sizeof(IV_parameter_set)};
+    return columns;
+  }
+  TrayCacheColumns CacheColumns(SPS_data* data) {
+    TrayCacheColumns columns = {&data->tray_note, &data->block, NULL, 0};
+    return columns;
+  }
+
+
+
+  // Data directory in use: ../data or ../data/{subdirectory}
+  // (the archive path when reading from an archive; its members are named as if it were a directory)
+  std::string GetDataDirectory() {
+    if (this->archive.IsOpen()) return this->archive.GetPath();
+    if (this->batch_data_dir.size() == 0) return "../data";
+    return "../data/" + batch_data_dir;
+  }
+  
+  // Path to one of the result files of a tray in the current tray list
+  // Follows the same directory convention as CheckValidTray:
+  //   ../data/[subdirectory/]{tray}[-robot][-results]/{filename}
+  std::string GetTrayFile(int tray_index, const char* filename) {
+    std::string directory = TrayManifest::DirectoryName(this->tray_strings.at(tray_index),
+                                                        this->tray_modes.at(tray_index) == 1,
+                                                        this->has_subscript_results);
+    return GetDataDirectory() + "/" + directory + "/" + filename;
+  }// End of SiPMDataReader::GetTrayFile
+
+
+
+  // Decide whether a read over n_trays should be spread over the worker threads
+  bool UseParallelIngest(int n_trays, bool print_all_SiPMs) {
+    return this->n_threads > 1 && n_trays > 1 && !print_all_SiPMs;
+  }
   
+  // Run task(i_tray) for every tray index in [first_tray, last_tray) on up to n_threads worker threads.
+  // Trays are handed out one at a time, so a slow file does not hold up a fixed block of trays.
+  // The task must only write to its own tray slot.
+  template <typename Task>
+  void RunOnTrays(int first_tray, int last_tray, Task task) {
+    int n_workers = std::min(this->n_threads, last_tray - first_tray);
+    std::atomic<int> next_tray(first_tray);
+    std::vector<std::thread> workers;
+    for (int i_worker = 0; i_worker < n_workers; ++i_worker) {
+      workers.push_back(std::thread([&]() {
+        for (int i_tray = next_tray++; i_tray < last_tray; i_tray = next_tray++) task(i_tray);
+      }));
+    }for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) it->join();
+  }// End of SiPMDataReader::RunOnTrays
+
   // End of data input utility
   
 public:
@@ -300,18 +824,16 @@ public:
     this->read_for_systematics = false;
     this->has_subscript_results = true;
     this->modified_SPS_output_format = false;
+    this->read_verbose_SPS = false;
     
     this->verbose_mode = true;
     this->print_IV_all_SiPMs = false;
     this->print_SPS_all_SiPMs = false;
-    
-    this->tray_strings = new std::vector<std::string>();
-    this->tray_modes = new std::vector<int>();
-    this->IV_internal = new std::vector<struct IV_data*>();
-    this->SPS_internal = new std::vector<struct SPS_data*>();
-    
-    this->batch_data_file = new std::string();
-    this->batch_data_dir = new std::string();
+    this->n_threads = 1;
+    this->use_tray_cache = true;
+    this->has_IV_data = false;
+    this->has_SPS_data = false;
+    this->data_generation = NextDataGeneration();
     
     gReader = this;
   }
@@ -320,17 +842,18 @@ public:
     this->read_for_systematics = false;
     this->has_subscript_results = true;
     this->modified_SPS_output_format = false;
+    this->read_verbose_SPS = false;
     
     this->verbose_mode = true;
     this->print_IV_all_SiPMs = false;
     this->print_SPS_all_SiPMs = false;
+    this->n_threads = 1;
+    this->use_tray_cache = true;
+    this->has_IV_data = false;
+    this->has_SPS_data = false;
+    this->data_generation = NextDataGeneration();
     
-    this->tray_strings = new std::vector<std::string>();
-    this->tray_modes = new std::vector<int>();
-    this->IV_internal = new std::vector<struct IV_data*>();
-    this->SPS_internal = new std::vector<struct SPS_data*>();
-    
-    this->batch_data_file = new std::string(batch_file);
+    this->batch_data_file = batch_file;
     GetBatchStrings();
     
     gReader = this;
@@ -340,19 +863,43 @@ public:
   
   void                          GetDataDebrecen()     {GetBatchStrings();}                    // Assumes data is formatted as in Debrecen test stand
   void                          GetDataORNL()         {return;} // Not implemented -- no data from ORNL provided as of now.
-  std::vector<IV_data*>*        GetIV()               {return this->IV_internal;}
-  std::vector<SPS_data*>*       GetSPS()              {return this->SPS_internal;}
-  std::vector<std::string>*     GetTrayStrings()      {return this->tray_strings;}
-  std::vector<int>*             GetTrayModes()        {return this->tray_modes;}
+  std::vector<IV_data*>*        GetIV()               {return &this->IV_internal;}    // Owned by the reader: valid until the next ReadFile/ReadDataIV
+  std::vector<SPS_data*>*       GetSPS()              {return &this->SPS_internal;}   // Owned by the reader: valid until the next ReadFile/ReadDataSPS
+  std::vector<std::string>*     GetTrayStrings()      {return &this->tray_strings;}
+  std::vector<int>*             GetTrayModes()        {return &this->tray_modes;}
+  std::string                   GetDataDir()          {return GetDataDirectory();}              // Directory the tray results are read from
+  bool                          HasSubscriptResults() {return this->has_subscript_results;}
+  ParseDiagnostics*             GetDiagnostics()      {return &this->diagnostics;}    // Issues of every file read since the last ReadFile
   
   void                          SetSystematicMode()   {this->read_for_systematics = true;}        // should be run before running GetDataDebrecen
   void                          SetFlatTrayString()   {this->has_subscript_results = false;}      // do not automatically require "-results" in tray strings
   void                          SetModifiedSPSFormat(){this->modified_SPS_output_format = true;}  // Account for 2 extra columns in the SPS data
+  void                          SetReadVerboseSPS()   {this->read_verbose_SPS = true;}           // Fill SPS_steepness_unc/SPS_gain from SPS_result.txt
+  void                          SetNoVerboseSPS()     {this->read_verbose_SPS = false;}          // Leave them at -999 (default)
   void                          SetDefTrayString()    {this->has_subscript_results = true;}       // do require "-results" in tray strings (typical convention)
   void                          SetVerbose()          {this->verbose_mode = true;}                // Print some small information about accessed data
   void                          SetQuiet()            {this->verbose_mode = false;}               // Print essentially nothing to the terminal
   void                          SetPrintIV()          {this->print_IV_all_SiPMs = true;}
   void                          SetPrintSPS()         {this->print_SPS_all_SiPMs = true;}
+  void                          SetUseCache()         {this->use_tray_cache = true;}   // load/rebuild binary tray caches (default)
+  void                          SetNoCache()          {this->use_tray_cache = false;}  // always parse the text files, never write caches
+  
+  // Parse trays on n worker threads (n <= 0: one per available core, 1: serial)
+  // Tray order, and therefore all tray indices, is the same for any n
+  void SetThreads(int n) {
+    if (n <= 0) n = std::thread::hardware_concurrency();
+    this->n_threads = std::max(n, 1);
+  }
+  int                           GetThreads()          {return this->n_threads;}
+  uint64_t                      GetDataGeneration()   {return this->data_generation;}  // Changes whenever the IV/SPS data changes: key for caches of derived statistics
+  
+  // List every line skipped (or only partly read) since the last ReadFile, per file
+  void PrintDiagnostics() {
+    if (this->diagnostics.GetNFiles() == 0) {
+      std::cout << "No parse issues in the files read." << std::endl;
+      return;
+    }this->diagnostics.Print();
+  }
 
   // *---------------- Dynamic/Interfacing Getters
   
@@ -360,12 +907,11 @@ public:
   // Helpful when working with a large volume of data
   void SetSubDirectory(const char* subdir) {
     
-    char full_directory[100];
-    snprintf(full_directory, 100, "../data/%s", subdir);
+    std::string full_directory = std::string("../data/") + subdir;
     
     // Stat the subdirectory to make sure it exists
     struct stat check_dir;
-    if (stat(full_directory, &check_dir) != 0) {// Failed to find directory
+    if (stat(full_directory.c_str(), &check_dir) != 0) {// Failed to find directory
       std::cout << t_red << "Error" << t_def << " in <SiPMDataReader::SetSubDirectory>:";
       std::cout << " Requested directory {" << full_directory << "} not found." << std::endl;
       return;
@@ -373,26 +919,77 @@ public:
     
     // Set the local subdirectory
     std::cout << "Sourcing data from subdirectory ../data/" << t_blu << subdir << t_def << std::endl;
-    batch_data_dir = new std::string(subdir);
+    this->batch_data_dir = subdir;
     return;
   }
   
+  // Read trays from a batch archive (.tar, .tar.gz/.tgz, .tar.zst/.tzst) instead of the data directory.
+  // A bare file name is looked up in ../data, a path is used as given. The archive is read once,
+  // here; the following ReadFile/ReadData calls then validate and parse the trays from memory.
+  // Archive members are not cached. Use SetNoArchive to go back to the data directory.
+  void SetArchive(const char* archive_file) {
+    std::string path = archive_file;
+    if (path.find('/') == std::string::npos) path = "../data/" + path;
+    
+    if (!this->archive.Open(path)) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMDataReader::SetArchive>:";
+      std::cout << " Could not read archive {" << path << "}." << std::endl;
+      return;
+    }
+    std::cout << "Sourcing data from archive " << t_blu << path << t_def << " (";
+    std::cout << t_mgn << this->archive.GetNDirectories() << t_def << " result directories)" << std::endl;
+    
+    // Result directories are found by name; same-name directories elsewhere in the archive are not read
+    const std::vector<std::string>& duplicates = this->archive.GetDuplicates();
+    for (int i = 0; i < duplicates.size(); ++i) {
+      std::cout << t_red << "Warning" << t_def << " in <SiPMDataReader::SetArchive>: {" << t_red << duplicates[i] << t_def;
+      std::cout << "} has the same name as a result directory read earlier in the archive and is skipped." << std::endl;
+    }
+  }
+  void SetNoArchive() {this->archive.Close();}
+  
   // Read in tray data from a text file
   // Overwrites any existing data if present
   void ReadFile(const char* filename) {
-    this->tray_strings->clear();
-    this->IV_internal->clear();
-    this->SPS_internal->clear();
+    this->tray_strings.clear();
+    this->tray_modes.clear();
+    ClearTrayIndex();
+    ClearIV();
+    ClearSPS();
+    this->diagnostics.Clear();
     
-    this->batch_data_file = new std::string(filename);
+    this->batch_data_file = filename;
     GetBatchStrings();
   }
   
   // Add more trays to an already existing list without overwriting current data
+  // Only trays not yet in the list are validated, and if IV/SPS data has already been
+  // read, only those trays are parsed. Existing trays keep their data and indices.
+  // A tray is kept per (tray, cassette/robot) entry: a robot result that appears later for
+  // a loaded cassette tray is appended as a new entry, while an entry already in the list
+  // is never re-read--use ReadFile for a full reload.
   void AppendFile(const char* filename) {
-    this->batch_data_file = new std::string(filename);
-    GetBatchStrings();
-  }
+    int n_loaded = this->tray_strings.size();
+    
+    this->batch_data_file = filename;
+    GetBatchStrings(true);
+    ReadAppendedTrays(n_loaded);
+  }// End of SiPMDataReader::AppendFile
+  
+  // Same as AppendFile, for trays given directly rather than in a tray list file
+  // (e.g. from a TrayResultWatcher)
+  void AppendTrays(const std::vector<std::string>& trays) {
+    int n_loaded = this->tray_strings.size();
+    
+    std::vector<std::string> requested_trays;
+    for (std::vector<std::string>::const_iterator it = trays.begin(); it != trays.end(); ++it) {
+      if (HasTrayEntry(*it, 0) && HasTrayEntry(*it, 1)) continue;
+      if (std::find(requested_trays.begin(), requested_trays.end(), *it) == requested_trays.end()) requested_trays.push_back(*it);
+    }if (requested_trays.empty()) return;
+    
+    AddTrays(requested_trays, true);
+    ReadAppendedTrays(n_loaded);
+  }// End of SiPMDataReader::AppendTrays
   
   // Convert a cassette test index (set#, cassette#) to manufactory tray index (i,j)
   std::pair<int,int> GetTrayIndexFromTestIndex(int set, int cassette_index) {
@@ -407,34 +1004,104 @@ public:
   // Get the IV Breakdown Voltage for a single SiPM using input tray index (i,j)
   float GetVbdTrayIndexIV(int tray_index, int row, int col, bool temperature_corrected = false) {
     if (temperature_corrected) {
-      return this->IV_internal->at(tray_index)->IV_Vpeak_25C->at(23*row + col);
-    }return this->IV_internal->at(tray_index)->IV_Vpeak->at(23*row + col);
+      return this->IV_internal.at(tray_index)->IV_Vpeak_25C->at(23*row + col);
+    }return this->IV_internal.at(tray_index)->IV_Vpeak->at(23*row + col);
   }
   
   // Get the IV Breakdown Voltage for a single SiPM using input cassette test index (set#, cassette#)
   float GetVbdTestIndexIV(int tray_index, int set, int cassette_index, bool temperature_corrected = false) {
     if (temperature_corrected) {
-      return this->IV_internal->at(tray_index)->IV_Vpeak_25C->at(32*set + cassette_index);
-    }return this->IV_internal->at(tray_index)->IV_Vpeak->at(32*set + cassette_index);
+      return this->IV_internal.at(tray_index)->IV_Vpeak_25C->at(32*set + cassette_index);
+    }return this->IV_internal.at(tray_index)->IV_Vpeak->at(32*set + cassette_index);
   }
   
   // Get the SPS Breakdown Voltage for a single SiPM using input tray index (i,j)
   float GetVbdTrayIndexSPS(int tray_index, int row, int col, bool temperature_corrected = false) {
     if (temperature_corrected) {
-      return this->SPS_internal->at(tray_index)->SPS_Vbd_25C->at(23*row + col);
-    }return this->SPS_internal->at(tray_index)->SPS_Vbd->at(23*row + col);
+      return this->SPS_internal.at(tray_index)->SPS_Vbd_25C->at(23*row + col);
+    }return this->SPS_internal.at(tray_index)->SPS_Vbd->at(23*row + col);
   }
   
   // Get the SPS Breakdown Voltage for a single SiPM using input cassette test index (set#, cassette#)
   float GetVbdTestIndexSPS(int tray_index, int set, int cassette_index, bool temperature_corrected = false) {
     if (temperature_corrected) {
-      return this->SPS_internal->at(tray_index)->SPS_Vbd_25C->at(32*set + cassette_index);
-    }return this->SPS_internal->at(tray_index)->SPS_Vbd->at(32*set + cassette_index);
+      return this->SPS_internal.at(tray_index)->SPS_Vbd_25C->at(32*set + cassette_index);
+    }return this->SPS_internal.at(tray_index)->SPS_Vbd->at(32*set + cassette_index);
+  }
+  
+  // Slot of a tray in the tray list for the given mode (0 cassette, 1 robot), -1 if not loaded
+  int FindTray(const std::string& tray, int mode = 0) {
+    if (mode < 0 || mode >= this->tray_index.size()) return -1;
+    std::unordered_map<std::string, int>::const_iterator it = this->tray_index[mode].find(tray);
+    return it == this->tray_index[mode].end() ? -1 : it->second;
+  }
+  
+  // Batch label of a tray ID: the part before the '-' (the test date), e.g. "250821" for "250821-1301"
+  static std::string BatchLabel(const std::string& tray) {return tray.substr(0, tray.find('-'));}
+  
+  // Test batches of the tray list, in order of their first tray (built as trays are listed)
+  int                           GetNBatches()                  {return this->batches.size();}
+  const TrayBatch&              GetBatch(int batch)            {return this->batches.at(batch);}
+  const std::vector<TrayBatch>& GetBatches()                   {return this->batches;}
+  
+  // Slot of a batch label in GetBatch, -1 if no listed tray is in it
+  int FindBatch(const std::string& label) {
+    std::unordered_map<std::string, int>::const_iterator it = this->batch_index.find(label);
+    return it == this->batch_index.end() ? -1 : it->second;
+  }
+  
+  // Locate a SiPM from its ID, e.g. "250821-1301_0_2" (tray 250821-1301, column 0, row 2).
+  // Robot SPS IDs carry n_trailing_fields extra "_x" fields after the indices.
+  SiPMLocation FindSiPM(const std::string& SiPM_id, int mode = 0, int n_trailing_fields = 0) {
+    SiPMLocation location = {-1, -1};
+    const char* id_begin = SiPM_id.data();
+    const char* prefix_end;
+    int ccol, crow;
+    if (!splitSiPMIndex(id_begin, id_begin + SiPM_id.size(), n_trailing_fields, ccol, crow, &prefix_end)) return location;
+    if (crow < 0 || ccol < 0 || crow >= NROW || ccol >= NCOL) return location;
+    location.tray_index = FindTray(std::string(id_begin, prefix_end), mode);
+    if (location.IsValid()) location.flattened_index = crow*NCOL + ccol;
+    return location;
   }
   
   // Check if a given tray has a requested SiPM cassette test set (0-14)
   bool HasSet(int tray_index, int set_index) {
-    return (this->IV_internal->at(tray_index)->IV_Vpeak->at(32*set_index) != -999);
+    return (this->IV_internal.at(tray_index)->IV_Vpeak->at(32*set_index) != -999);
+  }
+  
+  // IV parameter set (test time and stand settings) of a tray; requires ReadDataIV
+  const IV_parameter_set& GetParameterSet(int tray_index) {
+    return this->IV_internal.at(tray_index)->parameters;
+  }
+  
+  // Unix time [s] the tray's IV measurement started, -999 if its parameter set was not readable
+  int64_t GetTestTime(int tray_index) {
+    return GetParameterSet(tray_index).timestamp;
+  }
+  
+  // Tray indices ordered by IV test time (trays without a readable time go last, in list order)
+  std::vector<int> GetTraysByTestTime() {
+    std::vector<int> order(this->IV_internal.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+      const IV_parameter_set& pa = GetParameterSet(a);
+      const IV_parameter_set& pb = GetParameterSet(b);
+      if (pa.valid != pb.valid) return pa.valid;
+      return pa.valid && pa.timestamp < pb.timestamp;
+    });
+    return order;
+  }
+  
+  // Tray indices grouped by identical stand settings, groups in order of first appearance.
+  // Trays without a readable parameter set form one group each.
+  std::vector<std::vector<int> > GroupTraysByStandSettings() {
+    std::vector<std::vector<int> > groups;
+    for (int i = 0; i < this->IV_internal.size(); ++i) {
+      int i_group = 0;
+      while (i_group < groups.size() && !GetParameterSet(i).SameSettings(GetParameterSet(groups[i_group][0]))) ++i_group;
+      if (i_group == groups.size()) groups.push_back(std::vector<int>());
+      groups[i_group].push_back(i);
+    }return groups;
   }
   
   
@@ -444,6 +1111,7 @@ public:
   
   // Read all IV data for the given valid batches obtained from I/O above
   // Output data is stored as a vector of pointers to data storage structs
+  // Each file is parsed in place by ReadTrayIV (layout in IV_format, see SiPMTraySchema.hpp)
   //
   // Note that IV data text file have the following column formats (Debrecen):IV HEADER:
   // TRAYID+NOTE, SIPMID, AVERAGE_TEMPERATURE, TEMPERATURE_DEVIATION, RAW_VPEAK, VPEAK(25C), IDARK(-3V)[nA], IDARK(+4V)[nA], TEMERATURE_BEFORE_IDARK_MEASUREMENT, FORWARD_RESISTANCE
@@ -451,162 +1119,61 @@ public:
   // 250821-1301-2ndcassette 250821-1301_0_2 23.535 0.026 38.2979 38.3460 1.2 7.6 23.60 105.52
   void ReadDataIV() {
     // Store data as a vector of data struct pointers
-    this->IV_internal = new std::vector<IV_data*>();
+    // Slots are filled in tray_strings order, regardless of the number of threads
+    ClearIV();
     
-    int i = 0;
-    if (verbose_mode) std::cout << "Gathering IV data for " << t_mgn << tray_strings->size() << t_def << " trays." << std::endl;
-    for (std::vector<std::string>::iterator it = tray_strings->begin(); it != tray_strings->end(); ++it) {
-      
-      // Form input file for this tray
-      char IV_file[150];
-      if (this->batch_data_dir->size() == 0) {    // No subdirectory
-        if (this->tray_modes->at(i) == 0) {      // Not robot data
-          if (this->has_subscript_results) snprintf(IV_file, 150, "../data/%s-results/IV_result.txt", it->c_str());
-          else                             snprintf(IV_file, 150, "../data/%s/IV_result.txt", it->c_str());
-        } else if (this->tray_modes->at(i) == 1) {// Is robot data
-          if (this->has_subscript_results) snprintf(IV_file, 150, "../data/%s-robot-results/IV_result.txt", it->c_str());
-          else                             snprintf(IV_file, 150, "../data/%s-robot/IV_result.txt", it->c_str());
-        }
-      } else {                                    // Has subdirectory
-        if (this->tray_modes->at(i) == 0) {       // Not robot data
-          if (this->has_subscript_results) snprintf(IV_file, 150, "../data/%s/%s-results/IV_result.txt", batch_data_dir->c_str(), it->c_str());
-          else                             snprintf(IV_file, 150, "../data/%s/%s/IV_result.txt", batch_data_dir->c_str(),it->c_str());
-        } else if (this->tray_modes->at(i) == 1) {// Is robot data
-          if (this->has_subscript_results) snprintf(IV_file, 150, "../data/%s/%s-robot-results/IV_result.txt", batch_data_dir->c_str(), it->c_str());
-          else                             snprintf(IV_file, 150, "../data/%s/%s-robot/IV_result.txt", batch_data_dir->c_str(), it->c_str());
-        }
-      }// End of possible directory tree
+    if (verbose_mode) std::cout << "Gathering IV data for " << t_mgn << tray_strings.size() << t_def << " trays." << std::endl;
+    ReadTraysIV(0);
+    this->has_IV_data = true;
+    
+    // Assign global pointer and return
+    if (verbose_mode) std::cout << "Finished gathering all IV data." << std::endl;
+    return;
+  }// End of SiPMDataReader::ReadDataIV
+  
+  
+  
+  // Parse IV data for the trays from first_tray to the end of the tray list
+  // Trays before first_tray keep their current data and slots
+  void ReadTraysIV(int first_tray) {
+    int n_trays = tray_strings.size();
+    int n_issues_before = this->diagnostics.GetNIssues();
+    IV_internal.resize(n_trays, NULL);
+    
+    // Form input file for each tray
+    std::vector<std::string> IV_files(n_trays);
+    for (int i = first_tray; i < n_trays; ++i) IV_files[i] = GetTrayFile(i, "IV_result.txt");
+    
+    // Per-SiPM printing is only readable in order, so it forces the serial loop
+    if (UseParallelIngest(n_trays - first_tray, print_IV_all_SiPMs)) {
+      RunOnTrays(first_tray, n_trays, [&](int i_tray) {
+        IV_internal.at(i_tray) = ReadTrayIV(IV_files[i_tray].c_str(), tray_strings.at(i_tray));
+      });
+      if (verbose_mode) std::cout << "Parsed IV data on " << t_mgn << std::min(n_threads, n_trays - first_tray) << t_def << " threads." << std::endl;
+    } else for (int i = first_tray; i < n_trays; ++i) {
       
       // Report about tray status if in verbose mode
       if (verbose_mode) {
         std::cout << "Gathering IV data for tray ";
-        if (!this->tray_modes->at(i)) std::cout << t_grn;
+        if (!this->tray_modes.at(i)) std::cout << t_grn;
         else                               std::cout << t_cyn;
-        std::cout << *it << t_def << "...";
-      }
-      
-      // *-- data arrays to append to data struct
-      IV_data* current_data = new IV_data();
-      std::vector<int>*   row_local           = new std::vector<int>;
-      std::vector<int>*   col_local           = new std::vector<int>;
-      // Temperature data
-      std::vector<float>* avg_temp_local      = new std::vector<float>;
-      std::vector<float>* stdev_temp_local    = new std::vector<float>;
-      // IV V_peak measurement
-      std::vector<float>* IV_Vpeak_local      = new std::vector<float>;
-      std::vector<float>* IV_Vpeak_25C_local  = new std::vector<float>;
-      // Dark current measurement
-      std::vector<float>* Idark_3below_local  = new std::vector<float>;
-      std::vector<float>* Idark_4above_local  = new std::vector<float>;
-      std::vector<float>* Idark_temp_local    = new std::vector<float>;
-      // Forward resistance measurement
-      std::vector<float>* forward_res_local   = new std::vector<float>;
-      
-      // initialize
-      for (int i = 0; i < NROW*NCOL; ++i) {
-        row_local->push_back(-999);
-        col_local->push_back(-999);
-        avg_temp_local->push_back(-999);
-        stdev_temp_local->push_back(-999);
-        IV_Vpeak_local->push_back(-999);
-        IV_Vpeak_25C_local->push_back(-999);
-        Idark_3below_local->push_back(-999);
-        Idark_4above_local->push_back(-999);
-        Idark_temp_local->push_back(-999);
-        forward_res_local->push_back(-999);
-        // -999: failed measurement or missing SiPM 
+        std::cout << tray_strings.at(i) << t_def << "...";
       }
       
       // *-- READ IV DATA FROM FILE
-      std::ifstream infile(IV_file);
-      
-      std::string data_line;
-      bool first_line = true;
-      getline(infile, data_line); // skip first line--not data
-      while (getline(infile, data_line)) {
-        std::stringstream linestream(data_line);
-        std::string entry;
-        
-        getline(linestream, entry, ' '); // 0: TRAYID+NOTE
-        if (first_line) current_data->tray_note = entry;
-        
-        getline(linestream, entry, ' '); // 1: SIPMID
-                                         // Final indices separated by underscores
-        std::stringstream array_stream(entry);
-        std::string c_underscore;
-        std::vector<std::string> underscore_delimeter;
-        while (getline(array_stream, c_underscore, '_')) underscore_delimeter.push_back(c_underscore);
-        // Compute flattened array index from recovered column/row identifier
-        int ccol = std::stoi(underscore_delimeter[underscore_delimeter.size()-2]);
-        int crow = std::stoi(underscore_delimeter[underscore_delimeter.size()-1]);
-        int flattened_index = crow*NCOL + ccol;
-        row_local->at(flattened_index) = crow;
-        col_local->at(flattened_index) = ccol;
-        
-        getline(linestream, entry, ' '); // 2: AVERAGE_TEMPERATURE[C]
-        avg_temp_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 3: TEMPERATURE_DEVIATION[C]
-        stdev_temp_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 4: RAW_VPEAK[V]
-        if (std::isnan(std::stof(entry))) continue; // nan handling in new output format
-        IV_Vpeak_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 5: VPEAK(25C)[V]
-        IV_Vpeak_25C_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 6: IDARK(-3V)[nA]
-        Idark_3below_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 7: IDARK(+4V)[nA]
-        Idark_4above_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 8: TEMERATURE_BEFORE_IDARK_MEASUREMENT[V]
-        Idark_temp_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 9: FORWARD_RESISTANCE[Ω] (TODO CHECK THIS IS THE RIGHT UNITS)
-        forward_res_local->at(flattened_index) = std::stof(entry);
-        
-        
-        // Report IV results of each SiPM if requested
-        if (print_IV_all_SiPMs) {
-          std::cout << "SiPM " << *it << " (" << t_blu << crow << t_def << ',' << t_blu << ccol << t_def << ") [" << flattened_index << "] :: " << std::endl;
-          std::cout << "Temp " << avg_temp_local->at(flattened_index) << "C +/- " << stdev_temp_local->at(flattened_index) << "C." << std::endl;
-          std::cout << "V_peak = " << IV_Vpeak_local->at(flattened_index) << "V >>> " << t_grn << IV_Vpeak_25C_local->at(flattened_index) << t_def << "V @25C. " << std::endl;
-          std::cout << "I_dark = " << Idark_3below_local->at(flattened_index) << "nA @(V_op-3), " << Idark_4above_local->at(flattened_index) << "nA @(V_op+4)" << std::endl;
-          std::cout << "I_dark measured at " << Idark_temp_local->at(flattened_index) << "C, forward resistance = " << forward_res_local->at(flattened_index) << " Ohm.\n" << std::endl;
-        }
-        
-        first_line = false;
-      }// End of processing current SiPM line
-      
-      // Append array pointers and push back to data struct vector
-      current_data->row           = row_local;
-      current_data->col           = col_local;
-      current_data->avg_temp      = avg_temp_local;
-      current_data->stdev_temp    = stdev_temp_local;
-      current_data->IV_Vpeak      = IV_Vpeak_local;
-      current_data->IV_Vpeak_25C  = IV_Vpeak_25C_local;
-      current_data->Idark_3below  = Idark_3below_local;
-      current_data->Idark_4above  = Idark_4above_local;
-      current_data->Idark_temp    = Idark_temp_local;
-      current_data->forward_res   = forward_res_local;
-      IV_internal->push_back(current_data);
+      IV_internal.at(i) = ReadTrayIV(IV_files[i].c_str(), tray_strings.at(i));
       
       if (verbose_mode) std::cout << "Done." << std::endl;
-      ++i; // Counter for Robot bool
     }// End of tray iterator
-    
-    // Assign global pointer and return
-    if (verbose_mode) std::cout << "Finished gathering all IV data." << std::endl;
-    return;
-  }// End of SiPMDataReader::ReadDataIV
+    WarnParseIssues("IV", n_issues_before);
+    this->data_generation = NextDataGeneration();
+  }// End of SiPMDataReader::ReadTraysIV
   
   
   
   // Read all SPS data for the given valid batches obtained from I/O above
   // Output data is stored as a vector of pointers to data storage structs
+  // Each file is parsed in place by ReadTraySPS (layout in SPS_format/SPS_robot_format, see SiPMTraySchema.hpp)
   //
   // Note that SPS data text file have the following column formats (Debrecen):
   // SIPMID, USED_PEAKS, FIT_WIDTH, ROW_VBD, AVERAGE_TEMPERATURE, TEMPERATURE_UNCERAINITY, VBD(25C), VBD_UNCERAINITY, chi2ndf, p0mean, p1mean
@@ -614,185 +1181,65 @@ public:
   // 250821-1301_0_2 4 400 37.7953 24.9493 0.00188982 37.797 0.0225818 0.117961 -3565.56 94.3384
   void ReadDataSPS() {
     // Store data as a vector of data struct pointers
-    this->SPS_internal = new std::vector<SPS_data*>();
+    // Slots are filled in tray_strings order, regardless of the number of threads
+    ClearSPS();
     
-    int i = 0;
-    if (verbose_mode) std::cout << "Gathering SPS data for " << t_mgn << tray_strings->size() << t_def << " trays." << std::endl;
-    for (std::vector<std::string>::iterator it = tray_strings->begin(); it != tray_strings->end(); ++it) {
-      
-      // Form input file for this tray
-      char SPS_file[150];
-      if (this->batch_data_dir->size() == 0) {    // No subdirectory
-        if (this->tray_modes->at(i) == 0) {      // Not robot data
-          if (this->has_subscript_results) snprintf(SPS_file, 150, "../data/%s-results/SPS_result_onlynumbers.txt", it->c_str());
-          else                             snprintf(SPS_file, 150, "../data/%s/SPS_result_onlynumbers.txt", it->c_str());
-        } else if (this->tray_modes->at(i) == 1) {// Is robot data
-          if (this->has_subscript_results) snprintf(SPS_file, 150, "../data/%s-robot-results/SPS_result_onlynumbers.txt", it->c_str());
-          else                             snprintf(SPS_file, 150, "../data/%s-robot/SPS_result_onlynumbers.txt", it->c_str());
-        }
-      } else {                                    // Has subdirectory
-        if (this->tray_modes->at(i) == 0) {       // Not robot data
-          if (this->has_subscript_results) snprintf(SPS_file, 150, "../data/%s/%s-results/SPS_result_onlynumbers.txt", batch_data_dir->c_str(), it->c_str());
-          else                             snprintf(SPS_file, 150, "../data/%s/%s/SPS_result_onlynumbers.txt", batch_data_dir->c_str(),it->c_str());
-        } else if (this->tray_modes->at(i) == 1) {// Is robot data
-          if (this->has_subscript_results) snprintf(SPS_file, 150, "../data/%s/%s-robot-results/SPS_result_onlynumbers.txt", batch_data_dir->c_str(), it->c_str());
-          else                             snprintf(SPS_file, 150, "../data/%s/%s-robot/SPS_result_onlynumbers.txt", batch_data_dir->c_str(), it->c_str());
-        }
-      }// End of possible directory tree
+    if (verbose_mode) std::cout << "Gathering SPS data for " << t_mgn << tray_strings.size() << t_def << " trays." << std::endl;
+    ReadTraysSPS(0);
+    this->has_SPS_data = true;
+    
+    // Assign global pointer and return
+    if (verbose_mode) std::cout << "Finished gathering all SPS data." << std::endl;
+    return;
+  }// End of SiPMDataReader::ReadDataSPS
+  
+  
+  
+  // Parse SPS data for the trays from first_tray to the end of the tray list
+  // Trays before first_tray keep their current data and slots
+  void ReadTraysSPS(int first_tray) {
+    int n_trays = tray_strings.size();
+    int n_issues_before = this->diagnostics.GetNIssues();
+    SPS_internal.resize(n_trays, NULL);
+    
+    // Form input file for each tray
+    std::vector<std::string> SPS_files(n_trays);
+    std::vector<std::string> SPS_verbose_files(n_trays);
+    for (int i = first_tray; i < n_trays; ++i) SPS_files[i] = GetTrayFile(i, "SPS_result_onlynumbers.txt");
+    if (read_verbose_SPS) for (int i = first_tray; i < n_trays; ++i) SPS_verbose_files[i] = GetTrayFile(i, "SPS_result.txt");
+    
+    // Per-SiPM printing is only readable in order, so it forces the serial loop
+    if (UseParallelIngest(n_trays - first_tray, print_SPS_all_SiPMs)) {
+      RunOnTrays(first_tray, n_trays, [&](int i_tray) {
+        SPS_internal.at(i_tray) = ReadTraySPS(SPS_files[i_tray].c_str(), tray_strings.at(i_tray));
+        if (read_verbose_SPS) ReadTraySPSVerbose(SPS_verbose_files[i_tray].c_str(), SPS_internal.at(i_tray));
+      });
+      if (verbose_mode) std::cout << "Parsed SPS data on " << t_mgn << std::min(n_threads, n_trays - first_tray) << t_def << " threads." << std::endl;
+    } else for (int i = first_tray; i < n_trays; ++i) {
       
       // Report about tray status if in verbose mode
       if (verbose_mode) {
         std::cout << "Gathering SPS data for tray ";
-        if (!this->tray_modes->at(i)) std::cout << t_grn;
+        if (!this->tray_modes.at(i)) std::cout << t_grn;
         else                               std::cout << t_cyn;
-        std::cout << *it << t_def << "...";
-      }
-      
-      // *-- data arrays to append to data struct
-      SPS_data* current_data = new SPS_data();
-      std::vector<int>*   row_local           = new std::vector<int>;
-      std::vector<int>*   col_local           = new std::vector<int>;
-      // Temperature data
-      std::vector<float>* avg_temp_local      = new std::vector<float>;
-      std::vector<float>* stdev_temp_local    = new std::vector<float>;
-      // SPS spectrum info
-      std::vector<int>*   SPS_npeaks_local    = new std::vector<int>;
-      std::vector<float>* SPS_peakwidth_local = new std::vector<float>;
-      // SPS V_breakdown measurement
-      std::vector<float>* SPS_Vbd_local       = new std::vector<float>;
-      std::vector<float>* SPS_Vbd_25C_local   = new std::vector<float>;
-      std::vector<float>* SPS_Vbd_unc_local   = new std::vector<float>;
-      std::vector<float>* SPS_chi2ndf_local   = new std::vector<float>;
-      // SPS fit parameters P0, P1
-      std::vector<float>* fit_parm_0_local    = new std::vector<float>;
-      std::vector<float>* fit_parm_1_local    = new std::vector<float>;
-      
-      // initialize
-      for (int i = 0; i < NROW*NCOL; ++i) {
-        row_local->push_back(-999);
-        col_local->push_back(-999);
-        avg_temp_local->push_back(-999);
-        stdev_temp_local->push_back(-999);
-        SPS_npeaks_local->push_back(-999);
-        SPS_peakwidth_local->push_back(-999);
-        SPS_Vbd_local->push_back(-999);
-        SPS_Vbd_25C_local->push_back(-999);
-        SPS_Vbd_unc_local->push_back(-999);
-        SPS_chi2ndf_local->push_back(-999);
-        fit_parm_0_local->push_back(-999);
-        fit_parm_1_local->push_back(-999);
-        // -999: failed measurement or missing SiPM
+        std::cout << tray_strings.at(i) << t_def << "...";
       }
       
       // *-- READ SPS DATA FROM FILE
-      std::ifstream infile(SPS_file);
-      
-      std::string data_line;
-      bool first_line = true;
-      while (getline(infile, data_line)) {
-        std::stringstream linestream(data_line);
-        std::string entry;
-        
-        getline(linestream, entry, ' '); // 0: SIPMID
-                                         // Final indices are separated by underscores
-        std::stringstream array_stream(entry);
-        std::string c_underscore;
-        std::vector<std::string> underscore_delimeter;
-        while (getline(array_stream, c_underscore, '_')) underscore_delimeter.push_back(c_underscore);
-        
-        // Compute flattened array index from recovered column/row identifier
-        // Account for possible change in formatting when testing robot
-        int ccol, crow;
-        if (this->modified_SPS_output_format) {
-          ccol = std::stoi(underscore_delimeter[underscore_delimeter.size()-4]);
-          crow = std::stoi(underscore_delimeter[underscore_delimeter.size()-3]);
-        } else {
-          ccol = std::stoi(underscore_delimeter[underscore_delimeter.size()-2]);
-          crow = std::stoi(underscore_delimeter[underscore_delimeter.size()-1]);
-        }
-        
-        int flattened_index = crow*NCOL + ccol;
-        row_local->at(flattened_index) = crow;
-        col_local->at(flattened_index) = ccol;
-        
-        // Measurement message is everything before this which may contain underscores
-        if (first_line) {
-          int n_to_subtract =  4 + (crow / 10 >= 1) + (ccol / 10 >= 1);
-          current_data->tray_note = entry.substr(0, entry.size() - n_to_subtract);
-          first_line = false;
-        }
-        
-        getline(linestream, entry, ' '); // 1: USED_PEAKS[NUMBER OF PEAKS FIT IN SPS]
-        SPS_npeaks_local->at(flattened_index) = std::stoi(entry);
-        
-        getline(linestream, entry, ' '); // 2: FIT_WIDTH[SPS PEAK WIDTH ASSUMED BY FITTER]
-        SPS_peakwidth_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 3: ROW_VBD[V] (AT MEASURED TEMPERATURE)
-        SPS_Vbd_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 4: AVERAGE_TEMPERATURE[C]
-        avg_temp_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 5: TEMPERATURE_UNCERAINITY[C]
-        stdev_temp_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 6: VBD(25C)[V]
-        SPS_Vbd_25C_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 7: VBD_UNCERAINITY[V] (MONTE CARLO ERROR ESTIMATION PROCEDURE)
-        SPS_Vbd_unc_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 8: CHI^2/NDF[LINEAR SPS GAIN FIT QUALITY]
-        SPS_chi2ndf_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 9: p0mean[AVG p0 AMONG SPS PEAKS]
-        fit_parm_0_local->at(flattened_index) = std::stof(entry);
-        
-        getline(linestream, entry, ' '); // 10: p0mean[AVG p1 AMONG SPS PEAKS]
-        fit_parm_1_local->at(flattened_index) = std::stof(entry);
-        
-        // Report SPS results of each SiPM if requested
-        if (print_SPS_all_SiPMs) {
-          std::cout << "SiPM " << *it << " (" << t_blu << crow << t_def << ',' << t_blu << ccol << t_def << ") [" << flattened_index << "] :: " << std::endl;
-          std::cout << "Temp " << avg_temp_local->at(flattened_index) << "C +/- " << stdev_temp_local->at(flattened_index) << "C." << std::endl;
-          std::cout << "SPS V_bd = " << SPS_Vbd_local->at(flattened_index) << "V >>> " << t_grn << SPS_Vbd_25C_local->at(flattened_index) << t_def << "V @25C (";
-          std::cout << "+/- " << t_grn << SPS_Vbd_unc_local->at(flattened_index) << t_def << ")." << std::endl;
-          std::cout << "SPS Extrapolation fit info :: # of peaks = " << SPS_npeaks_local->at(flattened_index) << " using width " << SPS_peakwidth_local->at(flattened_index);
-          std::cout << ", chi^2/ndf = " << SPS_chi2ndf_local->at(flattened_index) << "." << std::endl;
-          std::cout << "Fit parm means :: p0 = " << fit_parm_0_local->at(flattened_index) << ", p1 = " << fit_parm_1_local->at(flattened_index) << std::endl << std::endl;
-        }
-      }// End of processing current SiPM line
-      
-      // Append array pointers and push back to data struct vector
-      current_data->row           = row_local;
-      current_data->col           = col_local;
-      current_data->avg_temp      = avg_temp_local;
-      current_data->stdev_temp    = stdev_temp_local;
-      current_data->SPS_npeaks    = SPS_npeaks_local;
-      current_data->SPS_peakwidth = SPS_peakwidth_local;
-      current_data->SPS_Vbd       = SPS_Vbd_local;
-      current_data->SPS_Vbd_25C   = SPS_Vbd_25C_local;
-      current_data->SPS_Vbd_unc   = SPS_Vbd_unc_local;
-      current_data->SPS_chi2ndf   = SPS_chi2ndf_local;
-      current_data->fit_parm_0    = fit_parm_0_local;
-      current_data->fit_parm_1    = fit_parm_1_local;
-      SPS_internal->push_back(current_data);
+      SPS_internal.at(i) = ReadTraySPS(SPS_files[i].c_str(), tray_strings.at(i));
+      if (read_verbose_SPS) ReadTraySPSVerbose(SPS_verbose_files[i].c_str(), SPS_internal.at(i));
       
       if (verbose_mode) std::cout << "Done." << std::endl;
-      ++i; // Counter for Robot bool
     }// End of tray iterator
-    
-    // Assign global pointer and return
-    if (verbose_mode) std::cout << "Finished gathering all SPS data." << std::endl;
-    return;
-  }// End of SiPMDataReader::ReadDataSPS
+    WarnParseIssues("SPS", n_issues_before);
+    this->data_generation = NextDataGeneration();
+  }// End of SiPMDataReader::ReadTraysSPS
   
   // *---------------- Simple output formatters
   
   
   void WriteCompressedFile(int tray_index) {
-    int n_tray = this->tray_strings->size();
+    int n_tray = this->tray_strings.size();
     if (tray_index > n_tray) return;
     if (tray_index == -1) std::cout << "Writing condensed files for all tray data...";
     
@@ -802,14 +1249,14 @@ public:
       if (tray_index >= 0 && tray_index != i_tray) continue;
       
       
-      char outfile_dir[100];
-      snprintf(outfile_dir, 100, "../data/%s-results/results-condensed.txt",tray_strings->at(i_tray).c_str());
+      // Written next to the tray's result files
+      std::string outfile_dir = GetTrayFile(i_tray, "results-condensed.txt");
       if (tray_index != -1) std::cout << "Writing condensed file " << outfile_dir;
       
-      std::ofstream outfile(outfile_dir);
+      std::ofstream outfile(outfile_dir.c_str());
       
-      IV_data* tray_IV_data = IV_internal->at(i_tray);
-      SPS_data* tray_SPS_data = SPS_internal->at(i_tray);
+      IV_data* tray_IV_data = IV_internal.at(i_tray);
+      SPS_data* tray_SPS_data = SPS_internal.at(i_tray);
       
       for (int i = 0; i < tray_IV_data->IV_Vpeak->size(); ++i) {
         // May be helpful to have indices but for main table not necessary
@@ -830,8 +1277,8 @@ public:
   // *---------------- Destructor
   
   ~SiPMDataReader() {
-    delete this->IV_internal;
-    delete this->SPS_internal;
+    ClearIV();
+    ClearSPS();
   }// End of SiPMDataReader::~SiPMDataReader
   
 };
@@ -0,0 +1,170 @@
+//  *--
+//  SiPMDatasetRegistry.hpp
+//
+//  Named datasets, each with its own SiPMDataReader, so several studies
+//  (e.g. production and repsyst) can be held in memory at the same time.
+//  A dataset is read the first time it is requested; Load() reads a set
+//  of datasets in parallel, one thread per dataset.
+//
+//  The sipm_analysis_helper methods act on gReader, so switch between
+//  datasets with Use(name), which also makes that dataset's reader gReader.
+//  *--
+
+#ifndef SiPMDatasetRegistry_h
+#define SiPMDatasetRegistry_h
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "global_vars.hpp"
+#include "SiPMDataReader.hpp"
+
+// How to find and read one dataset
+struct DatasetSpec {
+  std::string subdirectory;       // Under ../data ("" for ../data itself)
+  std::string tray_list_file;     // Tray list read with SiPMDataReader::ReadFile
+  bool        has_subscript_results;
+  bool        modified_SPS_format;
+};// structdef :: DatasetSpec
+
+//========================================================================== SiPMDatasetRegistry
+
+class SiPMDatasetRegistry {
+private:
+  struct Dataset {
+    DatasetSpec     spec;
+    SiPMDataReader* reader;   // NULL until loaded
+  };// structdef :: Dataset
+
+  std::map<std::string, Dataset> datasets;
+  int  n_threads;
+  bool verbose_mode;
+
+  // Reader configured for a dataset. Constructed on the calling thread, since
+  // the SiPMDataReader constructor assigns gReader.
+  static SiPMDataReader* NewReader(const DatasetSpec& spec, int n_reader_threads, bool verbose) {
+    SiPMDataReader* reader = new SiPMDataReader();
+    if (!verbose) reader->SetQuiet();
+    reader->SetThreads(n_reader_threads);
+    if (spec.has_subscript_results) reader->SetDefTrayString();
+    else                            reader->SetFlatTrayString();
+    if (spec.modified_SPS_format)   reader->SetModifiedSPSFormat();
+    if (!spec.subdirectory.empty()) reader->SetSubDirectory(spec.subdirectory.c_str());
+    return reader;
+  }
+
+  // Read tray list, IV and SPS data. Runs on a worker thread in Load() and only touches its own reader.
+  static void ReadDataset(SiPMDataReader* reader, const DatasetSpec& spec) {
+    reader->ReadFile(spec.tray_list_file.c_str());
+    reader->ReadDataIV();
+    reader->ReadDataSPS();
+  }
+
+  // Not copyable: owns the readers
+  SiPMDatasetRegistry(const SiPMDatasetRegistry&);
+  SiPMDatasetRegistry& operator=(const SiPMDatasetRegistry&);
+
+public:
+  SiPMDatasetRegistry() {
+    this->n_threads = std::thread::hardware_concurrency();
+    if (this->n_threads < 1) this->n_threads = 1;
+    this->verbose_mode = false;
+  }
+
+  ~SiPMDatasetRegistry() {
+    for (std::map<std::string, Dataset>::iterator it = datasets.begin(); it != datasets.end(); ++it) delete it->second.reader;
+  }
+
+  // *---------------- Setters/Getters
+
+  void SetThreads(int n)  {this->n_threads = n > 0 ? n : std::max<int>(std::thread::hardware_concurrency(), 1);}  // Total over all datasets being read
+  void SetVerbose()       {this->verbose_mode = true;}   // Let each reader print as it reads (output of parallel loads interleaves)
+  void SetQuiet()         {this->verbose_mode = false;}  // One line per dataset (default)
+
+  bool Has(const std::string& name)      {return datasets.count(name) > 0;}
+  bool IsLoaded(const std::string& name) {return Has(name) && datasets[name].reader != NULL;}
+
+  // *---------------- Registration
+
+  // Declare a dataset; nothing is read until it is requested
+  void Register(const std::string& name, const std::string& subdirectory, const std::string& tray_list_file,
+                bool has_subscript_results = true, bool modified_SPS_format = false) {
+    if (IsLoaded(name)) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMDatasetRegistry::Register>: dataset " << name << " is already loaded." << std::endl;
+      return;
+    }
+    Dataset dataset;
+    dataset.spec.subdirectory = subdirectory;
+    dataset.spec.tray_list_file = tray_list_file;
+    dataset.spec.has_subscript_results = has_subscript_results;
+    dataset.spec.modified_SPS_format = modified_SPS_format;
+    dataset.reader = NULL;
+    datasets[name] = dataset;
+  }
+
+  // *---------------- Loading
+
+  // Read every requested dataset that is not loaded yet, one thread per dataset.
+  // The thread budget is shared, so each reader parses its trays on n_threads / n_datasets threads.
+  void Load(const std::vector<std::string>& names) {
+    std::vector<std::string> to_load;
+    for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+      if (!Has(*it)) {
+        std::cout << t_red << "Error" << t_def << " in <SiPMDatasetRegistry::Load>: unknown dataset " << *it << "." << std::endl;
+        continue;
+      }if (!IsLoaded(*it) && std::find(to_load.begin(), to_load.end(), *it) == to_load.end()) to_load.push_back(*it);
+    }if (to_load.empty()) return;
+
+    SiPMDataReader* previous_gReader = gReader; // Reader constructors claim gReader
+    int n_reader_threads = std::max<int>(1, this->n_threads / to_load.size());
+    std::vector<SiPMDataReader*> readers;
+    for (int i = 0; i < to_load.size(); ++i) readers.push_back(NewReader(datasets[to_load[i]].spec, n_reader_threads, this->verbose_mode));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < to_load.size(); ++i) workers.push_back(std::thread(ReadDataset, readers[i], datasets[to_load[i]].spec));
+    for (int i = 0; i < workers.size(); ++i) workers[i].join();
+
+    for (int i = 0; i < to_load.size(); ++i) {
+      datasets[to_load[i]].reader = readers[i];
+      std::cout << "Loaded dataset " << t_blu << to_load[i] << t_def << " (" << t_mgn << readers[i]->GetTrayStrings()->size() << t_def << " trays)." << std::endl;
+    }
+    gReader = previous_gReader;
+  }// End of SiPMDatasetRegistry::Load
+
+  void LoadAll() {
+    std::vector<std::string> names;
+    for (std::map<std::string, Dataset>::iterator it = datasets.begin(); it != datasets.end(); ++it) names.push_back(it->first);
+    Load(names);
+  }
+
+  // Free a dataset's data; it is read again the next time it is requested
+  void Unload(const std::string& name) {
+    if (!IsLoaded(name)) return;
+    if (gReader == datasets[name].reader) gReader = NULL;
+    delete datasets[name].reader;
+    datasets[name].reader = NULL;
+  }
+
+  // *---------------- Access
+
+  // Reader of a dataset, read now if it has not been yet (NULL for an unknown name)
+  SiPMDataReader* Get(const std::string& name) {
+    if (!Has(name)) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMDatasetRegistry::Get>: unknown dataset " << name << "." << std::endl;
+      return NULL;
+    }
+    if (!IsLoaded(name)) Load(std::vector<std::string>(1, name));
+    return datasets[name].reader;
+  }
+
+  // Get a dataset and make it the one the sipm_analysis_helper methods act on
+  SiPMDataReader* Use(const std::string& name) {
+    SiPMDataReader* reader = Get(name);
+    if (reader) gReader = reader;
+    return reader;
+  }
+};// End of SiPMDatasetRegistry
+
+#endif /* SiPMDatasetRegistry_h */
@@ -0,0 +1,354 @@
+//  *--
+//  SiPMFrameStats.hpp
+//
+//  RDataFrame backend for the tray statistics of sipm_analysis_helper.
+//  Instead of one loop over gReader per helper call, a single lazy event
+//  loop (multi-threaded with ROOT implicit MT) gathers every SiPM's
+//  V_peak, V_breakdown and dark current by tray. Tray and batch averages,
+//  standard deviations, outlier counts and dark current tallies are then
+//  all answered from that one pass.
+//  Values are filed at their SiPM index, not in arrival order, so the
+//  statistics come out the same however the entries were split over the
+//  threads (sums run in SiPM index order, as in the helpers).
+//
+//  The source is either the data loaded in a SiPMDataReader, or a file
+//  written by writeSiPMTree (SiPMTreeExport.hpp), so a batch can be
+//  summarized without its text files.
+//
+//  Usage:
+//    SiPMFrameStats stats;
+//    stats.Compute(gReader);                     // or stats.Compute("../data/production.root")
+//    stats.GetTray(0).avg_Vpeak;  stats.GetBatch("250821").n_outliers_Vbreakdown;
+//  *--
+
+#ifndef SiPMFrameStats_h
+#define SiPMFrameStats_h
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ROOT/RDataFrame.hxx"
+#include "TFile.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include "global_vars.hpp"
+#include "SiPMDataReader.hpp"
+#include "SiPMTrayStats.hpp"
+#include "sipm_analysis_helper.hpp"
+
+// Statistics of one tray entry, or of a set of them (batch)
+// Averages and standard deviations are over valid measurements only, as in sipm_analysis_helper.
+struct FrameTrayStats {
+  std::string tray;                 // Tray ID, or the batch label
+  int         mode;                 // 0 cassette, 1 robot (-1 for a batch)
+  int         n_valid_IV;
+  int         n_valid_SPS;
+  double      avg_Vpeak;
+  double      stdev_Vpeak;
+  double      avg_Vbreakdown;
+  double      stdev_Vbreakdown;
+  int         n_outliers_Vpeak;     // Against each tray's own center (outlier_center), or the all-tray one (flag_use_all_trays_for_averages)
+  int         n_outliers_Vbreakdown;
+  int         n_dark_over_limit;    // Idark at Vbd+4V above the dark current limit
+};// structdef :: FrameTrayStats
+
+//========================================================================== SiPMFrameStats
+
+class SiPMFrameStats {
+private:
+  // What the event loop gathers for one SiPM / one tray
+  struct FrameSiPM {
+    int   slot;                     // Tray entry the SiPM belongs to
+    int   index;                    // row*NCOL + col
+    float Vpeak;
+    float Vbreakdown;
+    float Idark;
+  };// structdef :: FrameSiPM
+  struct FrameTrayValues {
+    std::vector<float> Vpeak;       // By SiPM index during the event loop (-999: none), then valid values only
+    std::vector<float> Vbreakdown;
+    int                n_dark_over_limit;
+  };// structdef :: FrameTrayValues
+
+  int   n_threads;
+  float dark_current_limit;
+  bool  flag_run_at_25_celcius;
+  float extra_tolerance;
+
+  std::vector<std::string>     tray_strings;
+  std::vector<int>             tray_modes;
+  std::vector<FrameTrayValues> tray_values;   // Output of the event loop
+  std::vector<FrameTrayStats>  tray_stats;
+
+  static bool IsValid(float value) {return value != -999 && !std::isnan(value);}
+
+  // Run the event loop over a frame with a "sipm" column, filling tray_values
+  template <class Frame>
+  void Gather(Frame& frame) {
+    float limit = this->dark_current_limit;
+    std::vector<FrameTrayValues> identity(this->tray_strings.size());
+    for (int i = 0; i < identity.size(); ++i) {
+      identity[i].Vpeak.assign(NROW*NCOL, -999);
+      identity[i].Vbreakdown.assign(NROW*NCOL, -999);
+      identity[i].n_dark_over_limit = 0;
+    }
+
+    // Each processing slot fills its own copy; the copies are merged once at the end.
+    // A SiPM is seen by one slot only, so merging the filled indices is order independent.
+    auto gathered = frame.Aggregate(
+      [limit](std::vector<FrameTrayValues>& values, const FrameSiPM& sipm) {
+        if (sipm.slot < 0 || sipm.slot >= values.size() || sipm.index < 0 || sipm.index >= NROW*NCOL) return;
+        FrameTrayValues& tray = values[sipm.slot];
+        if (IsValid(sipm.Vpeak))      tray.Vpeak[sipm.index] = sipm.Vpeak;
+        if (IsValid(sipm.Vbreakdown)) tray.Vbreakdown[sipm.index] = sipm.Vbreakdown;
+        if (IsValid(sipm.Idark) && sipm.Idark > limit) ++tray.n_dark_over_limit;
+      },
+      [](std::vector<std::vector<FrameTrayValues> >& partials) {
+        for (int i = 1; i < partials.size(); ++i) {
+          for (int j = 0; j < partials[0].size(); ++j) {
+            for (int k = 0; k < NROW*NCOL; ++k) {
+              if (partials[i][j].Vpeak[k] != -999)      partials[0][j].Vpeak[k] = partials[i][j].Vpeak[k];
+              if (partials[i][j].Vbreakdown[k] != -999) partials[0][j].Vbreakdown[k] = partials[i][j].Vbreakdown[k];
+            }
+            partials[0][j].n_dark_over_limit += partials[i][j].n_dark_over_limit;
+          }
+        }
+      },
+      "sipm", identity);
+    this->tray_values = *gathered; // Triggers the event loop
+
+    // Keep the valid values, in SiPM index order
+    for (int i = 0; i < this->tray_values.size(); ++i) {
+      std::vector<float>& Vpeak = this->tray_values[i].Vpeak;
+      std::vector<float>& Vbreakdown = this->tray_values[i].Vbreakdown;
+      Vpeak.erase(std::remove(Vpeak.begin(), Vpeak.end(), -999.f), Vpeak.end());
+      Vbreakdown.erase(std::remove(Vbreakdown.begin(), Vbreakdown.end(), -999.f), Vbreakdown.end());
+    }
+  }// End of SiPMFrameStats::Gather
+
+  static void MeanStdev(const std::vector<float>& values, double& avg, double& stdev) {
+    double sum = 0, sum_squared_deviation = 0;
+    for (int i = 0; i < values.size(); ++i) sum += values[i];
+    avg = sum / static_cast<double>(values.size());
+    for (int i = 0; i < values.size(); ++i) sum_squared_deviation += (values[i] - avg)*(values[i] - avg);
+    stdev = std::sqrt(sum_squared_deviation / static_cast<double>(values.size()));
+  }
+
+  static int CountOutside(const std::vector<float>& values, double center, double half_width) {
+    int count = 0;
+    for (int i = 0; i < values.size(); ++i) count += std::fabs(values[i] - center) >= half_width;
+    return count;
+  }
+
+  // Center of the outlier window (outlier_center, as sipm_analysis_helper::getOutlierCenter); selects on a copy
+  static double OutlierCenter(const std::vector<float>& values, double avg) {
+    if (outlier_center == kCenterMean) return avg;
+    std::vector<float> scratch(values);
+    if (outlier_center == kCenterMedian) return selectQuantile(scratch.data(), scratch.size(), 0.5);
+    return selectTrimmedMean(scratch.data(), scratch.size(), outlier_trim_fraction);
+  }
+
+  // Per-tray statistics from the gathered values (same definitions as sipm_analysis_helper)
+  void Summarize() {
+    double V_outlier = getOutlierRange(this->extra_tolerance);
+
+    this->tray_stats.assign(this->tray_values.size(), FrameTrayStats());
+    for (int i = 0; i < this->tray_values.size(); ++i) {
+      FrameTrayStats& stats = this->tray_stats[i];
+      stats.tray = this->tray_strings[i];
+      stats.mode = this->tray_modes[i];
+      stats.n_valid_IV = this->tray_values[i].Vpeak.size();
+      stats.n_valid_SPS = this->tray_values[i].Vbreakdown.size();
+      stats.n_dark_over_limit = this->tray_values[i].n_dark_over_limit;
+      MeanStdev(this->tray_values[i].Vpeak, stats.avg_Vpeak, stats.stdev_Vpeak);
+      MeanStdev(this->tray_values[i].Vbreakdown, stats.avg_Vbreakdown, stats.stdev_Vbreakdown);
+    }
+
+    // Outliers against the tray or all-tray centers
+    double all_Vpeak_center = 0, all_Vbreakdown_center = 0;
+    if (flag_use_all_trays_for_averages) {
+      FrameTrayStats all = GetAll();
+      std::vector<float> Vpeak, Vbreakdown;
+      if (outlier_center != kCenterMean) {
+        for (int i = 0; i < this->tray_values.size(); ++i) {
+          Vpeak.insert(Vpeak.end(), this->tray_values[i].Vpeak.begin(), this->tray_values[i].Vpeak.end());
+          Vbreakdown.insert(Vbreakdown.end(), this->tray_values[i].Vbreakdown.begin(), this->tray_values[i].Vbreakdown.end());
+        }
+      }
+      all_Vpeak_center = OutlierCenter(Vpeak, all.avg_Vpeak);
+      all_Vbreakdown_center = OutlierCenter(Vbreakdown, all.avg_Vbreakdown);
+    }
+    for (int i = 0; i < this->tray_values.size(); ++i) {
+      FrameTrayStats& stats = this->tray_stats[i];
+      double Vpeak_center      = flag_use_all_trays_for_averages ? all_Vpeak_center
+                                                                 : OutlierCenter(this->tray_values[i].Vpeak, stats.avg_Vpeak);
+      double Vbreakdown_center = flag_use_all_trays_for_averages ? all_Vbreakdown_center
+                                                                 : OutlierCenter(this->tray_values[i].Vbreakdown, stats.avg_Vbreakdown);
+      stats.n_outliers_Vpeak = CountOutside(this->tray_values[i].Vpeak, Vpeak_center, V_outlier);
+      stats.n_outliers_Vbreakdown = CountOutside(this->tray_values[i].Vbreakdown, Vbreakdown_center, V_outlier);
+    }
+  }// End of SiPMFrameStats::Summarize
+
+  // Combined statistics of the tray entries of batch label (SiPMDataReader::BatchLabel), or of all of them
+  FrameTrayStats Combine(const std::string& label, bool all_trays) {
+    FrameTrayStats combined = FrameTrayStats();
+    combined.tray = label;
+    combined.mode = -1;
+    std::vector<float> Vpeak, Vbreakdown;
+    for (int i = 0; i < this->tray_values.size(); ++i) {
+      if (!all_trays && SiPMDataReader::BatchLabel(this->tray_strings[i]) != label) continue;
+      Vpeak.insert(Vpeak.end(), this->tray_values[i].Vpeak.begin(), this->tray_values[i].Vpeak.end());
+      Vbreakdown.insert(Vbreakdown.end(), this->tray_values[i].Vbreakdown.begin(), this->tray_values[i].Vbreakdown.end());
+      combined.n_dark_over_limit += this->tray_values[i].n_dark_over_limit;
+      if (i < this->tray_stats.size()) {
+        combined.n_outliers_Vpeak += this->tray_stats[i].n_outliers_Vpeak;
+        combined.n_outliers_Vbreakdown += this->tray_stats[i].n_outliers_Vbreakdown;
+      }
+    }
+    combined.n_valid_IV = Vpeak.size();
+    combined.n_valid_SPS = Vbreakdown.size();
+    MeanStdev(Vpeak, combined.avg_Vpeak, combined.stdev_Vpeak);
+    MeanStdev(Vbreakdown, combined.avg_Vbreakdown, combined.stdev_Vbreakdown);
+    return combined;
+  }// End of SiPMFrameStats::Combine
+
+  // Implicit MT for the duration of one Compute: switched on only if this object enabled
+  // it, and off again when the event loop is done, so the rest of the session keeps its threading
+  struct ImplicitMTScope {
+    bool enabled_here;
+    ImplicitMTScope(int n_threads) : enabled_here(n_threads != 1 && !ROOT::IsImplicitMTEnabled()) {
+      if (enabled_here) ROOT::EnableImplicitMT(n_threads > 0 ? n_threads : 0);
+    }
+    ~ImplicitMTScope() {if (enabled_here) ROOT::DisableImplicitMT();}
+  };// structdef :: ImplicitMTScope
+
+public:
+  SiPMFrameStats() {
+    this->n_threads = 0;
+    this->dark_current_limit = Hamamatsu_spec_max_Idark;
+    this->flag_run_at_25_celcius = true;
+    this->extra_tolerance = 0;
+  }
+
+  // *---------------- Setters/Getters
+
+  void SetThreads(int n)              {this->n_threads = n;}     // Implicit MT threads during Compute (0: ROOT's choice, 1: serial); if MT is already on it is used as is
+  void SetDarkCurrentLimit(float lim) {this->dark_current_limit = lim;}
+  void SetTemperatureCorrected()      {this->flag_run_at_25_celcius = true;}   // Use the 25C corrected voltages (default)
+  void SetRawTemperature()            {this->flag_run_at_25_celcius = false;}  // Use the voltages at the recorded temperature
+  void SetExtraTolerance(float tol)   {this->extra_tolerance = tol;}           // Added to the outlier range as in countOutliersVpeak
+
+  int                   GetNTrays()              {return this->tray_stats.size();}
+  const FrameTrayStats& GetTray(int tray_index)  {return this->tray_stats.at(tray_index);}
+  FrameTrayStats        GetBatch(const std::string& batch_label) {return Combine(batch_label, false);}  // e.g. "250821"
+  FrameTrayStats        GetAll()                 {return Combine("", true);}
+
+  // *---------------- Event loops
+
+  // Statistics of the data loaded in reader (IV and SPS must have been read)
+  // Tray indices are the reader's.
+  bool Compute(SiPMDataReader* reader = gReader) {
+    if (!reader) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMFrameStats::Compute>: no reader given." << std::endl;
+      return false;
+    }
+    ImplicitMTScope threads(this->n_threads);
+    this->tray_strings = *reader->GetTrayStrings();
+    this->tray_modes = *reader->GetTrayModes();
+    const std::vector<IV_data*>*  IV_trays  = reader->GetIV();
+    const std::vector<SPS_data*>* SPS_trays = reader->GetSPS();
+    bool corrected = this->flag_run_at_25_celcius;
+
+    // One entry per SiPM slot of every tray; the entry number locates the SiPM
+    ROOT::RDataFrame empty_frame(static_cast<ULong64_t>(this->tray_strings.size())*NROW*NCOL);
+    auto frame = empty_frame.Define("sipm", [IV_trays, SPS_trays, corrected](ULong64_t entry) {
+      FrameSiPM sipm;
+      sipm.slot = entry / (NROW*NCOL);
+      int i = entry % (NROW*NCOL);
+      sipm.index = i;
+      IV_data*  IV  = sipm.slot < IV_trays->size()  ? IV_trays->at(sipm.slot)  : NULL;
+      SPS_data* SPS = sipm.slot < SPS_trays->size() ? SPS_trays->at(sipm.slot) : NULL;
+      sipm.Vpeak      = !IV  ? -999 : (corrected ? IV->IV_Vpeak_25C[i] : IV->IV_Vpeak[i]);
+      sipm.Vbreakdown = !SPS ? -999 : (corrected ? SPS->SPS_Vbd_25C[i] : SPS->SPS_Vbd[i]);
+      sipm.Idark      = !IV  ? -999 : IV->Idark_4above[i];
+      return sipm;
+    }, {"rdfentry_"});
+    Gather(frame);
+    Summarize();
+    return true;
+  }// End of SiPMFrameStats::Compute
+
+  // Statistics of a file written by writeSiPMTree. Tray indices follow its tray tree.
+  // Returns false (with an error) if the file cannot be opened or lacks its tray/sipm trees.
+  bool Compute(const char* root_file) {
+    const std::string suffix = this->flag_run_at_25_celcius ? "_25C" : "";
+    const char* tray_branches[2] = {"tray", "mode"};
+    std::string sipm_branches[6] = {"tray", "mode", "index", "IV_Vpeak" + suffix, "SPS_Vbd" + suffix, "Idark_4above"};
+
+    // RDataFrame throws on a missing file, tree or branch: check them first
+    TFile* infile = TFile::Open(root_file, "READ");
+    if (!infile || infile->IsZombie()) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMFrameStats::Compute>: could not open " << root_file << std::endl;
+      delete infile;
+      return false;
+    }
+    TTree* tray_tree = dynamic_cast<TTree*>(infile->Get("tray"));
+    TTree* sipm_tree = dynamic_cast<TTree*>(infile->Get("sipm"));
+    bool readable = tray_tree && sipm_tree;
+    for (int i = 0; readable && i < 2; ++i) readable = tray_tree->GetBranch(tray_branches[i]);
+    for (int i = 0; readable && i < 6; ++i) readable = sipm_tree->GetBranch(sipm_branches[i].c_str());
+    infile->Close();
+    delete infile;
+    if (!readable) {
+      std::cout << t_red << "Error" << t_def << " in <SiPMFrameStats::Compute>: " << root_file;
+      std::cout << " has no tray/sipm trees with the needed branches (see writeSiPMTree)." << std::endl;
+      return false;
+    }
+
+    ImplicitMTScope threads(this->n_threads);
+
+    // Tray list from the (small) tray tree
+    ROOT::RDataFrame tray_frame("tray", root_file);
+    auto trays = tray_frame.Take<std::string>("tray");
+    auto modes = tray_frame.Take<int>("mode");
+    this->tray_strings = *trays;
+    this->tray_modes = *modes;
+    std::map<std::pair<std::string, int>, int> slots;
+    for (int i = 0; i < this->tray_strings.size(); ++i) slots[std::make_pair(this->tray_strings[i], this->tray_modes[i])] = i;
+
+    ROOT::RDataFrame sipm_frame("sipm", root_file);
+    auto frame = sipm_frame.Define("sipm", [&slots](const std::string& tray, int mode, int index, float Vpeak, float Vbreakdown, float Idark) {
+      FrameSiPM sipm;
+      std::map<std::pair<std::string, int>, int>::const_iterator it = slots.find(std::make_pair(tray, mode));
+      sipm.slot = it == slots.end() ? -1 : it->second;
+      sipm.index = index;
+      sipm.Vpeak = Vpeak;
+      sipm.Vbreakdown = Vbreakdown;
+      sipm.Idark = Idark;
+      return sipm;
+    }, {sipm_branches[0], sipm_branches[1], sipm_branches[2], sipm_branches[3], sipm_branches[4], sipm_branches[5]});
+    Gather(frame);
+    Summarize();
+    return true;
+  }// End of SiPMFrameStats::Compute
+
+  // One line per tray entry, then the total
+  void Print() {
+    for (int i = 0; i <= this->tray_stats.size(); ++i) {
+      FrameTrayStats stats = i < this->tray_stats.size() ? this->tray_stats[i] : GetAll();
+      if (i < this->tray_stats.size()) std::cout << "Tray " << (stats.mode ? t_cyn : t_grn) << stats.tray << t_def;
+      else                             std::cout << "All trays";
+      std::cout << " :: V_peak " << stats.avg_Vpeak << " +/- " << stats.stdev_Vpeak << " V (" << stats.n_valid_IV << ")";
+      std::cout << ", V_bd " << stats.avg_Vbreakdown << " +/- " << stats.stdev_Vbreakdown << " V (" << stats.n_valid_SPS << ")";
+      std::cout << ", outliers IV/SPS " << t_mgn << stats.n_outliers_Vpeak << t_def << '/' << t_mgn << stats.n_outliers_Vbreakdown << t_def;
+      std::cout << ", " << stats.n_dark_over_limit << " over Idark limit" << std::endl;
+    }
+  }// End of SiPMFrameStats::Print
+};// End of SiPMFrameStats
+
+#endif /* SiPMFrameStats_h */
@@ -0,0 +1,138 @@
+//  *--
+//  SiPMParseDiagnostics.hpp
+//
+//  Record of the lines skipped while parsing result files.
+//  The parsers never throw on bad input: a malformed line is skipped and
+//  noted here with its file, line number and reason, and parsing goes on.
+//  Each file's issues are collected locally and merged once per file, so
+//  the parallel tray ingest does not contend on every bad line.
+//  *--
+
+#ifndef SiPMParseDiagnostics_h
+#define SiPMParseDiagnostics_h
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "global_vars.hpp"
+
+// Why a line was skipped (or only partly read)
+enum ParseIssueType {
+  kIssueOpenFailed,       // File could not be opened/mapped
+  kIssueBadHeader,        // Header row (IV parameter set) missing or unreadable
+  kIssueBadSiPMID,        // SiPM ID token has no "_col_row" indices (e.g. a stray header line)
+  kIssueIndexOutOfRange,  // Indices outside the NROW x NCOL tray
+  kIssueDuplicateSiPM,    // Second line for the same SiPM (the later line is kept)
+  kIssueMissingField,     // Line ends before all value columns (e.g. truncated write)
+  kIssueBadField          // Value column is not a number
+};
+
+inline const char* parseIssueName(ParseIssueType type) {
+  switch (type) {
+    case kIssueOpenFailed:      return "cannot open file";
+    case kIssueBadHeader:       return "bad parameter set row";
+    case kIssueBadSiPMID:       return "bad SiPM ID";
+    case kIssueIndexOutOfRange: return "SiPM index out of range";
+    case kIssueDuplicateSiPM:   return "duplicate SiPM";
+    case kIssueMissingField:    return "missing column";
+    case kIssueBadField:        return "bad value";
+  }return "unknown";
+}
+
+// One skipped or partly read line
+struct ParseIssue {
+  int            line;     // 1-based line number in the file (0 for file level issues)
+  ParseIssueType type;
+  int            field;    // Value column that failed (0-based, after the SiPM ID), -1 if not a column issue
+  std::string    token;    // Offending token, truncated
+};// structdef :: ParseIssue
+
+// Issues of one file as collected by a parser
+struct ParseIssueList {
+  static const int max_kept = 50;   // Further issues of the same file are only counted
+  int n_issues;
+  std::vector<ParseIssue> issues;
+
+  ParseIssueList() : n_issues(0) {}
+
+  void Add(int line, ParseIssueType type, int field = -1, const char* token_begin = NULL, const char* token_end = NULL) {
+    if (n_issues++ >= max_kept) return;
+    ParseIssue issue;
+    issue.line = line;
+    issue.type = type;
+    issue.field = field;
+    if (token_begin) issue.token.assign(token_begin, token_end - token_begin > 32 ? token_begin + 32 : token_end);
+    issues.push_back(issue);
+  }
+};// structdef :: ParseIssueList
+
+//========================================================================== ParseDiagnostics
+
+class ParseDiagnostics {
+private:
+  struct FileIssues {
+    std::string    file;
+    ParseIssueList list;
+  };// structdef :: FileIssues
+
+  std::vector<FileIssues> files;
+  std::mutex              merge_lock;
+
+public:
+  // Merge the issues of one parsed file (no-op if it had none). Safe to call from worker threads.
+  void Add(const std::string& file, const ParseIssueList& list) {
+    if (list.n_issues == 0) return;
+    std::lock_guard<std::mutex> guard(merge_lock);
+    FileIssues entry;
+    entry.file = file;
+    entry.list = list;
+    files.push_back(entry);
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> guard(merge_lock);
+    files.clear();
+  }
+
+  int GetNFiles() {
+    std::lock_guard<std::mutex> guard(merge_lock);
+    return files.size();
+  }
+
+  int GetNIssues() {
+    std::lock_guard<std::mutex> guard(merge_lock);
+    int n = 0;
+    for (int i = 0; i < files.size(); ++i) n += files[i].list.n_issues;
+    return n;
+  }
+
+  // Issues of one type (among the ones kept, see ParseIssueList::max_kept)
+  int GetNIssues(ParseIssueType type) {
+    std::lock_guard<std::mutex> guard(merge_lock);
+    int n = 0;
+    for (int i = 0; i < files.size(); ++i) {
+      for (int j = 0; j < files[i].list.issues.size(); ++j) n += files[i].list.issues[j].type == type;
+    }return n;
+  }
+
+  // List every recorded issue, grouped by file
+  void Print(std::ostream& out = std::cout) {
+    std::lock_guard<std::mutex> guard(merge_lock);
+    for (int i = 0; i < files.size(); ++i) {
+      const ParseIssueList& list = files[i].list;
+      out << t_blu << files[i].file << t_def << " :: " << t_red << list.n_issues << t_def << " issue(s)" << std::endl;
+      for (int j = 0; j < list.issues.size(); ++j) {
+        const ParseIssue& issue = list.issues[j];
+        out << "   line " << issue.line << ": " << parseIssueName(issue.type);
+        if (issue.field >= 0)      out << " (column " << issue.field << " after the SiPM ID)";
+        if (!issue.token.empty())  out << " \"" << issue.token << '"';
+        out << std::endl;
+      }
+      if (list.n_issues > list.issues.size()) out << "   ... " << list.n_issues - list.issues.size() << " more" << std::endl;
+    }
+  }
+};// End of ParseDiagnostics
+
+#endif /* SiPMParseDiagnostics_h */
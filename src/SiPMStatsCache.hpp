@@ -0,0 +1,287 @@
+//  *--
+//  SiPMStatsCache.hpp
+//
+//  Memoized per-tray summary statistics for sipm_analysis_helper.
+//  Outlier counts, standard deviations and the batch summary plots all ask
+//  for the same tray (and all-tray) averages over and over; with
+//  flag_use_all_trays_for_averages every outlier count used to rescan the
+//  whole dataset. Here each (tray, field) entry, the field being a column
+//  member such as &IV_data::IV_Vpeak_25C, is computed once, on first use,
+//  with the one-pass maskedMoments kernel of SiPMTrayStats.hpp; batch
+//  (SiPMDataReader::GetBatch) and all-tray entries merge the tray entries.
+//  Medians and MADs (maskedMedianMAD) and trimmed means (per trim fraction)
+//  are cached the same way; all-tray ones select over the gathered valid
+//  entries of every tray.
+//
+//  Entries are tied to the reader's data generation (see
+//  SiPMDataReader::GetDataGeneration): reading, appending or freeing data,
+//  or switching gReader, drops the cache on the next lookup.
+//  Returned references stay valid until the cache is invalidated (new data
+//  generation or Invalidate), also across lookups of other fields.
+//  Not thread-safe; meant for the single-threaded analysis macros.
+//  *--
+
+#ifndef SiPMStatsCache_h
+#define SiPMStatsCache_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#include "SiPMDataReader.hpp"
+#include "SiPMTrayStats.hpp"
+
+// Valid-entry statistics of one column over one tray or over all trays
+struct TrayMoments {
+  int           n;        // Number of valid entries
+  double        avg;      // NaN if n == 0
+  double        stdev;    // Population standard deviation, sqrt(sum (x-avg)^2 / n)
+  float         min;
+  float         max;
+  MaskedMoments moments;  // Mergeable form of the above
+
+  void Set(const MaskedMoments& from) {
+    moments = from;
+    n = from.n;
+    avg = from.mean;
+    stdev = std::sqrt(from.Variance());
+    min = from.min;
+    max = from.max;
+  }
+};// structdef :: TrayMoments
+
+//========================================================================== Tray fields
+
+// A tray quantity is a pointer to a column member, e.g. &IV_data::Idark_4above or &SPS_data::SPS_Vbd_25C.
+// TrayField<Field> gives its data struct and the reader's trays of that struct at compile time.
+template <auto Field> struct TrayField;
+template <class Data, TrayColumn<float> Data::*Field>
+struct TrayField<Field> {
+  typedef Data data_type;
+
+  static std::vector<Data*>* Trays(SiPMDataReader* reader) {
+    if constexpr (std::is_same<Data, IV_data>::value) return reader->GetIV();
+    else                                              return reader->GetSPS();
+  }
+
+  // Column of a tray, NULL if the tray has no data of this type
+  static const TrayColumn<float>* Column(SiPMDataReader* reader, int tray_index) {
+    Data* data = Trays(reader)->at(tray_index);
+    return data ? &(data->*Field) : NULL;
+  }
+};// structdef :: TrayField
+
+// Small dense index per tray field, assigned on first use (cache slot)
+inline int nextTrayFieldKey() {
+  static int n_keys = 0;
+  return n_keys++;
+}
+template <auto Field>
+int trayFieldKey() {
+  static const int key = nextTrayFieldKey();
+  return key;
+}
+
+//========================================================================== TrayStatsCache
+
+class TrayStatsCache {
+private:
+  // Trimmed means of one field for one trim fraction
+  struct TrimmedEntries {
+    std::vector<double> trays;
+    std::vector<bool>   computed;
+    double              all;
+    bool                all_computed;
+    TrimmedEntries() : all(NAN), all_computed(false) {}
+  };// structdef :: TrimmedEntries
+
+  // Entries of one tray field
+  struct FieldEntries {
+    std::vector<TrayMoments> trays;
+    std::vector<bool>        computed;
+    std::vector<TrayMoments> batches;
+    std::vector<bool>        batch_computed;
+    std::vector<MaskedRobust> robust;
+    std::vector<bool>        robust_computed;
+    TrayMoments              all;
+    bool                     all_computed;
+    MaskedRobust             all_robust;
+    bool                     all_robust_computed;
+    std::map<double, TrimmedEntries> trimmed;  // By trim fraction
+    FieldEntries() : all_computed(false), all_robust_computed(false) {}
+  };// structdef :: FieldEntries
+
+  uint64_t                  generation;  // Data generation the entries belong to (0: none)
+  std::deque<FieldEntries>  fields;      // Indexed by trayFieldKey; a deque so adding a field keeps
+                                         // the entries of the others (and references to them) in place
+  uint64_t                  no_entries[tray_mask_words];  // Empty mask, for trays without data
+  std::vector<float>        scratch;     // Valid entries of all trays (GatherAll)
+
+  // Drop every entry if reader holds different data than the cached entries
+  void Sync(SiPMDataReader* reader) {
+    if (reader->GetDataGeneration() == this->generation) return;
+    Invalidate();
+    this->generation = reader->GetDataGeneration();
+  }
+
+  template <auto Field>
+  FieldEntries& Entries(SiPMDataReader* reader) {
+    Sync(reader);
+    int key = trayFieldKey<Field>();
+    if (key >= this->fields.size()) this->fields.resize(key + 1);
+    FieldEntries& entries = this->fields[key];
+    int n_trays = TrayField<Field>::Trays(reader)->size();
+    if (entries.computed.size() != n_trays) {
+      entries.trays.assign(n_trays, TrayMoments());
+      entries.computed.assign(n_trays, false);
+      entries.robust.assign(n_trays, MaskedRobust());
+      entries.robust_computed.assign(n_trays, false);
+      entries.trimmed.clear();
+    }
+    if (entries.batch_computed.size() != reader->GetNBatches()) {
+      entries.batches.assign(reader->GetNBatches(), TrayMoments());
+      entries.batch_computed.assign(reader->GetNBatches(), false);
+    }
+    return entries;
+  }
+
+public:
+  TrayStatsCache() : generation(0) {std::fill(no_entries, no_entries + tray_mask_words, 0);}
+
+  // Forget every entry (they are recomputed on the next lookup)
+  void Invalidate() {
+    this->generation = 0;
+    this->fields.clear();
+  }
+
+  // Statistics of one tray (tray_index must be valid for the field's data type)
+  template <auto Field>
+  const TrayMoments& Get(SiPMDataReader* reader, int tray_index) {
+    FieldEntries& entries = Entries<Field>(reader);
+    if (entries.computed.at(tray_index)) return entries.trays[tray_index];
+
+    const TrayColumn<float>* column = TrayField<Field>::Column(reader, tray_index);
+    entries.trays[tray_index].Set(column ? maskedMoments(*column) : maskedMoments(NULL, no_entries));
+    entries.computed[tray_index] = true;
+    return entries.trays[tray_index];
+  }// End of TrayStatsCache::Get
+
+  // Statistics over a set of trays, merged from the tray entries (not stored;
+  // trays without data of the field's type are skipped)
+  template <auto Field>
+  TrayMoments GetTrays(SiPMDataReader* reader, const std::vector<int>& trays) {
+    int n_trays = Entries<Field>(reader).trays.size();
+    MaskedMoments merged = maskedMoments(NULL, no_entries);
+    for (int i = 0; i < trays.size(); ++i) {
+      if (trays[i] >= 0 && trays[i] < n_trays) merged.Merge(Get<Field>(reader, trays[i]).moments);
+    }
+    TrayMoments result;
+    result.Set(merged);
+    return result;
+  }// End of TrayStatsCache::GetTrays
+
+  // Statistics over the trays of one batch (slot in SiPMDataReader::GetBatch)
+  template <auto Field>
+  const TrayMoments& GetBatch(SiPMDataReader* reader, int batch) {
+    FieldEntries& entries = Entries<Field>(reader);
+    if (entries.batch_computed.at(batch)) return entries.batches[batch];
+
+    entries.batches[batch] = GetTrays<Field>(reader, reader->GetBatch(batch).trays);
+    entries.batch_computed[batch] = true;
+    return entries.batches[batch];
+  }// End of TrayStatsCache::GetBatch
+
+  // Statistics over all trays of the field's data type (combined from the tray entries)
+  template <auto Field>
+  const TrayMoments& GetAll(SiPMDataReader* reader) {
+    FieldEntries& entries = Entries<Field>(reader);
+    if (entries.all_computed) return entries.all;
+
+    // Merged from the tray entries: no further pass over the data
+    MaskedMoments all = maskedMoments(NULL, no_entries);
+    for (int i = 0; i < entries.trays.size(); ++i) all.Merge(Get<Field>(reader, i).moments);
+    entries.all.Set(all);
+    entries.all_computed = true;
+    return entries.all;
+  }// End of TrayStatsCache::GetAll
+
+  // Median and MAD of one tray
+  template <auto Field>
+  const MaskedRobust& GetRobust(SiPMDataReader* reader, int tray_index) {
+    FieldEntries& entries = Entries<Field>(reader);
+    if (entries.robust_computed.at(tray_index)) return entries.robust[tray_index];
+
+    const TrayColumn<float>* column = TrayField<Field>::Column(reader, tray_index);
+    entries.robust[tray_index] = column ? maskedMedianMAD(*column) : maskedMedianMAD(NULL, no_entries);
+    entries.robust_computed[tray_index] = true;
+    return entries.robust[tray_index];
+  }// End of TrayStatsCache::GetRobust
+
+  // Median and MAD over all trays of the field's data type
+  template <auto Field>
+  const MaskedRobust& GetRobustAll(SiPMDataReader* reader) {
+    FieldEntries& entries = Entries<Field>(reader);
+    if (entries.all_robust_computed) return entries.all_robust;
+
+    std::vector<float>& values = GatherAll<Field>(reader);
+    entries.all_robust.n = values.size();
+    entries.all_robust.median = selectQuantile(values.data(), values.size(), 0.5);
+    entries.all_robust.mad = selectMAD(values.data(), values.size(), entries.all_robust.median);
+    entries.all_robust_computed = true;
+    return entries.all_robust;
+  }// End of TrayStatsCache::GetRobustAll
+
+  // Trimmed mean of one tray (see selectTrimmedMean)
+  template <auto Field>
+  double GetTrimmedMean(SiPMDataReader* reader, int tray_index, double trim_fraction) {
+    FieldEntries& entries = Entries<Field>(reader);
+    TrimmedEntries& trimmed = entries.trimmed[trim_fraction];
+    if (trimmed.computed.size() != entries.trays.size()) {
+      trimmed.trays.assign(entries.trays.size(), NAN);
+      trimmed.computed.assign(entries.trays.size(), false);
+    }
+    if (trimmed.computed.at(tray_index)) return trimmed.trays[tray_index];
+
+    const TrayColumn<float>* column = TrayField<Field>::Column(reader, tray_index);
+    trimmed.trays[tray_index] = column ? maskedTrimmedMean(*column, trim_fraction) : NAN;
+    trimmed.computed[tray_index] = true;
+    return trimmed.trays[tray_index];
+  }// End of TrayStatsCache::GetTrimmedMean
+
+  // Trimmed mean over all trays of the field's data type
+  template <auto Field>
+  double GetTrimmedMeanAll(SiPMDataReader* reader, double trim_fraction) {
+    TrimmedEntries& trimmed = Entries<Field>(reader).trimmed[trim_fraction];
+    if (trimmed.all_computed) return trimmed.all;
+
+    std::vector<float>& values = GatherAll<Field>(reader);
+    trimmed.all = selectTrimmedMean(values.data(), values.size(), trim_fraction);
+    trimmed.all_computed = true;
+    return trimmed.all;
+  }// End of TrayStatsCache::GetTrimmedMeanAll
+
+  // Valid entries of every tray, for selections over all data (e.g. selectQuantile).
+  // The buffer is reused: it is overwritten by the next GatherAll, GetRobustAll or GetTrimmedMeanAll.
+  template <auto Field>
+  std::vector<float>& GatherAll(SiPMDataReader* reader) {
+    Sync(reader);
+    int n_trays = TrayField<Field>::Trays(reader)->size();
+    this->scratch.resize(n_trays * tray_column_stride);
+    int n = 0;
+    for (int i = 0; i < n_trays; ++i) {
+      const TrayColumn<float>* column = TrayField<Field>::Column(reader, i);
+      if (column) n += maskedGather(column->data(), column->Mask(), this->scratch.data() + n);
+    }
+    this->scratch.resize(n);
+    return this->scratch;
+  }// End of TrayStatsCache::GatherAll
+};// End of TrayStatsCache
+
+// Shared by the sipm_analysis_helper methods
+TrayStatsCache gTrayStatsCache;
+
+#endif /* SiPMStatsCache_h */
@@ -0,0 +1,161 @@
+//  *--
+//  SiPMTextParser.hpp
+//
+//  Low-level tools for reading the test stand text output in place.
+//  Result files are memory mapped read-only and tokenized without
+//  copying; numbers are converted with std::from_chars where available.
+//  Used by SiPMDataReader, but has no dependence on the data structs.
+//  *--
+
+#ifndef SiPMTextParser_h
+#define SiPMTextParser_h
+
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//========================================================================== Mapped input file
+
+// Read-only view of a full text file.
+// The file is mapped with mmap and unmapped when the object goes out of scope.
+// A missing or empty file gives an empty view (begin() == end()).
+class MappedTextFile {
+private:
+  const char* data;
+  size_t      length;
+
+  // Not copyable: owns the mapping
+  MappedTextFile(const MappedTextFile&);
+  MappedTextFile& operator=(const MappedTextFile&);
+
+public:
+  MappedTextFile() {
+    this->data = NULL;
+    this->length = 0;
+  }
+
+  MappedTextFile(const char* filename) {
+    this->data = NULL;
+    this->length = 0;
+    Open(filename);
+  }
+
+  // Map a file (an object maps at most one); false if it is missing or empty
+  bool Open(const char* filename) {
+    if (this->data) return false;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_info;
+    if (fstat(fd, &file_info) == 0 && file_info.st_size > 0) {
+      void* mapped = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        this->data = static_cast<const char*>(mapped);
+        this->length = file_info.st_size;
+        madvise(mapped, this->length, MADV_SEQUENTIAL); // Files are read front to back once
+      }
+    }close(fd); // Mapping stays valid after the descriptor is closed
+    return this->data != NULL;
+  }
+
+  ~MappedTextFile() {
+    if (this->data) munmap(const_cast<char*>(this->data), this->length);
+  }
+
+  bool        IsOpen() const {return this->data != NULL;}
+  const char* begin()  const {return this->data;}
+  const char* end()    const {return this->data + this->length;}
+  size_t      size()   const {return this->length;}
+};// End of MappedTextFile
+
+//========================================================================== Tokenizing
+
+// Advance cursor to the end of the current line.
+// Sets line_end to the last character of the line (excluding any "\r\n")
+// and leaves cursor at the start of the next line.
+inline const char* nextLine(const char*& cursor, const char* buffer_end) {
+  const char* line_begin = cursor;
+  const char* newline = static_cast<const char*>(memchr(cursor, '\n', buffer_end - cursor));
+  const char* line_end = newline ? newline : buffer_end;
+  cursor = newline ? newline + 1 : buffer_end;
+  if (line_end > line_begin && *(line_end - 1) == '\r') --line_end;
+  return line_end;
+}
+
+// Get the next whitespace separated token in [cursor, line_end)
+// Returns false if the line has no more tokens.
+inline bool nextToken(const char*& cursor, const char* line_end, const char*& token_begin, const char*& token_end) {
+  while (cursor < line_end && (*cursor == ' ' || *cursor == '\t')) ++cursor;
+  if (cursor == line_end) return false;
+  token_begin = cursor;
+  while (cursor < line_end && *cursor != ' ' && *cursor != '\t') ++cursor;
+  token_end = cursor;
+  return true;
+}
+
+// If the line starts with prefix, move cursor past it and return true
+// Used for the "Label: value" lines of the verbose result files.
+inline bool skipPrefix(const char*& cursor, const char* line_end, const char* prefix) {
+  size_t n = strlen(prefix);
+  if (static_cast<size_t>(line_end - cursor) < n || memcmp(cursor, prefix, n) != 0) return false;
+  cursor += n;
+  return true;
+}
+
+// Recover the (column, row) indices from a SiPM ID such as "250821-1301_0_2".
+// The indices are the last two underscore separated fields, unless the ID
+// carries extra trailing fields (robot SPS output), which are skipped.
+// If prefix_end is given it is set to the underscore in front of the indices.
+inline bool splitSiPMIndex(const char* token_begin, const char* token_end, int n_trailing_fields, int& ccol, int& crow,
+                           const char** prefix_end = NULL) {
+  const char* field_end = token_end;
+  const char* underscores[2];
+  int n_found = 0;
+  for (const char* c = token_end; c > token_begin && n_found < 2; --c) {
+    if (*(c - 1) != '_') continue;
+    if (n_trailing_fields > 0) {--n_trailing_fields; field_end = c - 1; continue;}
+    underscores[n_found++] = c - 1;
+  }
+  if (n_found < 2) return false;
+
+  // underscores[1] precedes the column, underscores[0] precedes the row
+  if (prefix_end) *prefix_end = underscores[1];
+  std::from_chars_result res_col = std::from_chars(underscores[1] + 1, underscores[0], ccol);
+  std::from_chars_result res_row = std::from_chars(underscores[0] + 1, field_end, crow);
+  return res_col.ec == std::errc() && res_col.ptr == underscores[0]
+      && res_row.ec == std::errc() && res_row.ptr == field_end;
+}
+
+//========================================================================== Number conversion
+
+// Convert a full token to an integer
+template <typename Int>
+inline bool tokenToInt(const char* token_begin, const char* token_end, Int& value) {
+  std::from_chars_result res = std::from_chars(token_begin, token_end, value);
+  return res.ec == std::errc() && res.ptr == token_end;
+}
+
+// Convert a full token to a float. Accepts "nan" like std::stof does.
+// std::from_chars for floating point is not in every standard library
+// (older libc++ on macOS), so fall back to strtof on a local copy there.
+inline bool tokenToFloat(const char* token_begin, const char* token_end, float& value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  std::from_chars_result res = std::from_chars(token_begin, token_end, value);
+  return res.ec == std::errc() && res.ptr == token_end;
+#else
+  char local[64];
+  size_t n = token_end - token_begin;
+  if (n == 0 || n >= sizeof(local)) return false;
+  memcpy(local, token_begin, n);
+  local[n] = '\0';
+  char* parse_end;
+  value = strtof(local, &parse_end);
+  return parse_end == local + n;
+#endif
+}
+
+#endif /* SiPMTextParser_h */
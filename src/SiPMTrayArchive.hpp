@@ -0,0 +1,353 @@
+//  *--
+//  SiPMTrayArchive.hpp
+//
+//  Tray results read straight from a batch archive (.tar, .tar.gz/.tgz,
+//  .tar.zst/.tzst) instead of an extracted data directory.
+//  The archive is streamed once, front to back; only the result files of
+//  each {tray}[-robot][-results]/ directory are kept in memory, keyed the
+//  same way the reader names files on disk, so validation and parsing go
+//  through the usual manifest and parser.
+//
+//  Decompression uses zlib/zstd when built with the flags below, and the
+//  gzip/zstd command line tools through a pipe otherwise.
+//  *--
+
+#ifndef SiPMTrayArchive_h
+#define SiPMTrayArchive_h
+
+// Compiler flags to decompress in process (link with -lz / -lzstd)
+//#define SiPM_archive_zlib
+//#define SiPM_archive_zstd
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef SiPM_archive_zlib
+#include <zlib.h>
+#endif
+#ifdef SiPM_archive_zstd
+#include <zstd.h>
+#endif
+
+#include "SiPMDataManifest.hpp"
+
+//========================================================================== ArchiveStream
+
+// Sequential reader of the decompressed bytes of an archive file
+class ArchiveStream {
+private:
+  enum Kind {kNone, kPlain, kPipe, kGzip, kZstd};
+
+  Kind  kind;
+  FILE* file;           // kPlain, kPipe and the compressed input of kZstd
+  bool  failed;
+#ifdef SiPM_archive_zlib
+  gzFile gz_file;
+#endif
+#ifdef SiPM_archive_zstd
+  ZSTD_DCtx*        zstd_context;
+  std::vector<char> zstd_input;
+  ZSTD_inBuffer     zstd_in;
+#endif
+
+  static bool HasSuffix(const std::string& name, const char* suffix) {
+    size_t n = strlen(suffix);
+    return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+  }
+
+  // Run "{tool} -dc '{path}'" and read its output
+  bool OpenPipe(const char* tool, const std::string& path) {
+    std::string command = std::string(tool) + " -dc '";
+    for (size_t i = 0; i < path.size(); ++i) {
+      if (path[i] == '\'') command += "'\\''";
+      else                 command += path[i];
+    }command += "' 2>/dev/null";
+    this->file = popen(command.c_str(), "r");
+    this->kind = kPipe;
+    return this->file != NULL;
+  }
+
+  // Not copyable: owns the file/pipe
+  ArchiveStream(const ArchiveStream&);
+  ArchiveStream& operator=(const ArchiveStream&);
+
+public:
+  ArchiveStream() {
+    this->kind = kNone;
+    this->file = NULL;
+    this->failed = false;
+#ifdef SiPM_archive_zlib
+    this->gz_file = NULL;
+#endif
+#ifdef SiPM_archive_zstd
+    this->zstd_context = NULL;
+#endif
+  }
+
+  ~ArchiveStream() {Close();}
+
+  // Pick the decompressor from the file name
+  bool Open(const std::string& path) {
+    Close();
+    if (HasSuffix(path, ".gz") || HasSuffix(path, ".tgz")) {
+#ifdef SiPM_archive_zlib
+      this->gz_file = gzopen(path.c_str(), "rb");
+      this->kind = kGzip;
+      return this->gz_file != NULL;
+#else
+      return OpenPipe("gzip", path);
+#endif
+    }
+    if (HasSuffix(path, ".zst") || HasSuffix(path, ".tzst")) {
+#ifdef SiPM_archive_zstd
+      this->file = fopen(path.c_str(), "rb");
+      this->zstd_context = ZSTD_createDCtx();
+      this->zstd_input.resize(ZSTD_DStreamInSize());
+      this->zstd_in.src = &this->zstd_input[0];
+      this->zstd_in.size = 0;
+      this->zstd_in.pos = 0;
+      this->kind = kZstd;
+      return this->file != NULL && this->zstd_context != NULL;
+#else
+      return OpenPipe("zstd", path);
+#endif
+    }
+    this->file = fopen(path.c_str(), "rb");
+    this->kind = kPlain;
+    return this->file != NULL;
+  }// End of ArchiveStream::Open
+
+  // Read up to n bytes; fewer only at the end of the data or on an error
+  size_t Read(char* buffer, size_t n) {
+    switch (this->kind) {
+      case kPlain:
+      case kPipe:
+        return this->file ? fread(buffer, 1, n, this->file) : 0;
+#ifdef SiPM_archive_zlib
+      case kGzip: {
+        size_t n_read = 0;
+        while (n_read < n) {
+          int chunk = gzread(this->gz_file, buffer + n_read, static_cast<unsigned>(n - n_read));
+          if (chunk <= 0) {this->failed |= chunk < 0; break;}
+          n_read += chunk;
+        }return n_read;
+      }
+#endif
+#ifdef SiPM_archive_zstd
+      case kZstd: {
+        ZSTD_outBuffer out = {buffer, n, 0};
+        while (out.pos < out.size) {
+          if (this->zstd_in.pos == this->zstd_in.size) {
+            this->zstd_in.size = fread(&this->zstd_input[0], 1, this->zstd_input.size(), this->file);
+            this->zstd_in.pos = 0;
+            if (this->zstd_in.size == 0) break;
+          }
+          if (ZSTD_isError(ZSTD_decompressStream(this->zstd_context, &out, &this->zstd_in))) {this->failed = true; break;}
+        }return out.pos;
+      }
+#endif
+      default: return 0;
+    }
+  }// End of ArchiveStream::Read
+
+  // Read and drop n bytes
+  bool Skip(size_t n) {
+    char buffer[16384];
+    while (n > 0) {
+      size_t chunk = n < sizeof(buffer) ? n : sizeof(buffer);
+      if (Read(buffer, chunk) != chunk) return false;
+      n -= chunk;
+    }return true;
+  }
+
+  // Returns false if the decompressor reported an error (for a pipe: the tool failed)
+  bool Close() {
+    bool ok = !this->failed;
+    if (this->kind == kPipe && this->file) {
+      // Drain the tool's output (tar padding after the end blocks) so it exits cleanly rather than on SIGPIPE
+      char buffer[16384];
+      while (fread(buffer, 1, sizeof(buffer), this->file) > 0) continue;
+      ok = pclose(this->file) == 0 && ok;
+    } else if (this->file) fclose(this->file);
+#ifdef SiPM_archive_zlib
+    if (this->gz_file) gzclose(this->gz_file);
+    this->gz_file = NULL;
+#endif
+#ifdef SiPM_archive_zstd
+    if (this->zstd_context) ZSTD_freeDCtx(this->zstd_context);
+    this->zstd_context = NULL;
+#endif
+    this->file = NULL;
+    this->kind = kNone;
+    this->failed = false;
+    return ok;
+  }// End of ArchiveStream::Close
+};// End of ArchiveStream
+
+//========================================================================== TrayArchive
+
+class TrayArchive {
+private:
+  std::string archive_path;                                // Also the prefix of every member key
+  std::unordered_map<std::string, std::string> members;    // "{archive}/{directory}/{file}" -> contents
+  std::unordered_map<std::string, unsigned>    directories; // Result directory -> TrayFileFlags
+  std::unordered_map<std::string, std::string> directory_paths; // Result directory -> its full path in the archive
+  std::vector<std::string>                     duplicates;  // Full paths of skipped same-name result directories
+
+  // Value of an octal tar header field (GNU base-256 for large sizes)
+  static uint64_t HeaderNumber(const char* field, int length) {
+    uint64_t value = 0;
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+      for (int i = 1; i < length; ++i) value = (value << 8) | static_cast<unsigned char>(field[i]);
+      return value;
+    }
+    for (int i = 0; i < length && field[i]; ++i) {
+      if (field[i] >= '0' && field[i] <= '7') value = 8*value + (field[i] - '0');
+    }return value;
+  }
+
+  // Header checksum: byte sum with the checksum field read as spaces
+  static bool ValidHeader(const char* header) {
+    uint64_t sum = 0;
+    for (int i = 0; i < 512; ++i) sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+    return sum == HeaderNumber(header + 148, 8);
+  }
+
+  // Path from a pax extended header ("{length} path={value}\n" records)
+  static std::string PaxPath(const std::string& records) {
+    size_t pos = 0;
+    while (pos < records.size()) {
+      size_t space = records.find(' ', pos);
+      if (space == std::string::npos) break;
+      size_t length = strtoul(records.c_str() + pos, NULL, 10);
+      if (length == 0 || pos + length > records.size()) break;
+      if (records.compare(space + 1, 5, "path=") == 0) return records.substr(space + 6, pos + length - space - 7);
+      pos += length;
+    }return "";
+  }
+
+  static unsigned ResultFileFlag(const std::string& file) {
+    if (file == "IV_result.txt")              return kFileIV;
+    if (file == "SPS_result_onlynumbers.txt") return kFileSPSNumbers;
+    if (file == "SPS_result.txt")             return kFileSPSVerbose;
+    return 0;
+  }
+
+  // Not copyable: can hold a full batch of result files
+  TrayArchive(const TrayArchive&);
+  TrayArchive& operator=(const TrayArchive&);
+
+public:
+  TrayArchive() {}
+
+  // Stream through an archive and keep the result files of its result directories.
+  // A result file is filed under its parent directory name, whatever the path above it.
+  // If directories of the same name sit under different paths, the first one in the
+  // archive is kept and the others are listed in GetDuplicates.
+  // Returns false (and holds nothing) if the archive cannot be read.
+  bool Open(const std::string& path) {
+    Close();
+    ArchiveStream stream;
+    if (!stream.Open(path)) return false;
+    this->archive_path = path;
+
+    char header[512];
+    std::string long_name;   // From a GNU 'L' or pax 'x' entry, applies to the next member
+    bool ok = false;
+    while (stream.Read(header, 512) == 512) {
+      if (header[0] == '\0') {ok = true; break;} // End of archive blocks
+      if (!ValidHeader(header)) break;
+
+      uint64_t size = HeaderNumber(header + 124, 12);
+      uint64_t padded_size = (size + 511)/512*512;
+      char type = header[156];
+
+      // Long names come as their own entries before the member they name
+      if (type == 'L' || type == 'x') {
+        std::string content(size, '\0');
+        if (size && stream.Read(&content[0], size) != size) break;
+        if (!stream.Skip(padded_size - size)) break;
+        long_name = type == 'L' ? std::string(content.c_str()) : PaxPath(content);
+        continue;
+      }
+
+      // pax global headers ('g', defaults for all later members) and GNU long link names ('K')
+      // hold nothing the reader uses; skip them without consuming a pending long name
+      if (type == 'g' || type == 'K') {
+        if (!stream.Skip(padded_size)) break;
+        continue;
+      }
+
+      std::string name = long_name;
+      long_name.clear();
+      if (name.empty()) {
+        name.assign(header, strnlen(header, 100));
+        if (strncmp(header + 257, "ustar", 5) == 0 && header[345]) name = std::string(header + 345, strnlen(header + 345, 155)) + "/" + name;
+      }
+
+      // Keep {directory}/{result file} members, skip everything else
+      size_t file_sep = name.rfind('/');
+      size_t dir_begin = 0;
+      if (file_sep != std::string::npos && file_sep > 0) {
+        size_t dir_sep = name.rfind('/', file_sep - 1);
+        if (dir_sep != std::string::npos) dir_begin = dir_sep + 1;
+      }
+      unsigned flag = 0;
+      if (file_sep != std::string::npos && file_sep > dir_begin) flag = ResultFileFlag(name.substr(file_sep + 1));
+      if ((type == '0' || type == '\0') && flag) {
+        std::string directory = name.substr(dir_begin, file_sep - dir_begin);
+        std::string directory_path = name.substr(0, file_sep);
+        std::pair<std::unordered_map<std::string, std::string>::iterator, bool> first_seen = this->directory_paths.emplace(directory, directory_path);
+        if (!first_seen.second && first_seen.first->second != directory_path) {
+          if (std::find(this->duplicates.begin(), this->duplicates.end(), directory_path) == this->duplicates.end()) this->duplicates.push_back(directory_path);
+          if (!stream.Skip(padded_size)) break;
+          continue;
+        }
+        std::string key = this->archive_path + "/" + directory + "/" + name.substr(file_sep + 1);
+        std::string& content = this->members[key];
+        content.resize(size);
+        if (size && stream.Read(&content[0], size) != size) break;
+        if (!stream.Skip(padded_size - size)) break;
+        this->directories[directory] |= flag;
+      } else if (!stream.Skip(padded_size)) break;
+    }// End of archive entries
+    if (!stream.Close() || !ok) {
+      Close();
+      return false;
+    }return true;
+  }// End of TrayArchive::Open
+
+  void Close() {
+    this->archive_path.clear();
+    this->members.clear();
+    this->directories.clear();
+    this->directory_paths.clear();
+    this->duplicates.clear();
+  }
+
+  bool               IsOpen()          const {return !this->archive_path.empty();}
+  const std::string& GetPath()         const {return this->archive_path;}
+  int                GetNDirectories() const {return this->directories.size();}
+  const std::vector<std::string>& GetDuplicates() const {return this->duplicates;}  // Skipped directories (see Open)
+
+  // Contents of a result file, by the path the reader uses for it ({archive}/{directory}/{file}); NULL if absent
+  const std::string* GetMember(const std::string& key) const {
+    std::unordered_map<std::string, std::string>::const_iterator it = this->members.find(key);
+    return it == this->members.end() ? NULL : &it->second;
+  }
+
+  // Index the archive's result directories in a manifest, as TrayManifest::Scan does for a directory
+  void FillManifest(TrayManifest& manifest) const {
+    manifest.Clear(this->archive_path);
+    for (std::unordered_map<std::string, unsigned>::const_iterator it = this->directories.begin(); it != this->directories.end(); ++it) {
+      manifest.AddDirectory(it->first, it->second);
+    }
+  }
+};// End of TrayArchive
+
+#endif /* SiPMTrayArchive_h */
@@ -0,0 +1,156 @@
+//  *--
+//  SiPMTrayBlock.hpp
+//
+//  Contiguous per-tray storage for SiPM test results.
+//  Every per-SiPM quantity of a tray is a fixed NROW*NCOL column, and all
+//  columns of a tray share one aligned allocation (structure of arrays).
+//  TrayColumn gives a light view of one column which keeps the old
+//  "data->IV_Vpeak->at(i)" access syntax working while code is migrated.
+//  Each column also carries a validity bitmask, filled at ingest, so a
+//  failed measurement or missing SiPM is a state rather than a magic number.
+//  *--
+
+#ifndef SiPMTrayBlock_h
+#define SiPMTrayBlock_h
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "global_vars.hpp"
+
+// Column length in the block: NROW*NCOL padded so each column starts on a 64-byte boundary.
+// Padding entries hold -999 like any missing SiPM.
+const int    tray_column_stride = ((NROW*NCOL + 15) / 16) * 16;
+const size_t tray_block_alignment = 64;
+static_assert(sizeof(int) == 4 && sizeof(float) == 4, "TrayBlock assumes 4-byte int and float columns");
+
+// Validity bitmask of a column: bit (i % 64) of word (i / 64) is set if entry i holds a measurement.
+// Bits of padding entries are never set.
+const int tray_mask_words = (tray_column_stride + 63) / 64;
+
+//========================================================================== Column view
+
+// Non-owning view of one NROW*NCOL column in a TrayBlock.
+// Behaves like the std::vector<T>* members it replaces:
+//   - "column->at(i)", "column->size()", "column->begin()" still compile, since
+//     operator-> returns the view itself
+//   - at(i) is bounds checked, operator[] and data() are not
+// IsValid(i)/Mask() give the validity of each entry (see TrayBlock::BuildMasks)
+template <typename T>
+class TrayColumn {
+private:
+  T*              values;
+  const uint64_t* valid_mask;
+
+public:
+  typedef T* iterator;
+  typedef const T* const_iterator;
+
+  TrayColumn() : values(NULL), valid_mask(NULL) {}
+  TrayColumn(T* column_values, const uint64_t* column_mask) : values(column_values), valid_mask(column_mask) {}
+
+  // Pointer-style access for code written against std::vector<T>*
+  TrayColumn*       operator->()       {return this;}
+  const TrayColumn* operator->() const {return this;}
+
+  T& at(size_t i) {
+    if (i >= size()) throw std::out_of_range("TrayColumn::at");
+    return values[i];
+  }
+  const T& at(size_t i) const {
+    if (i >= size()) throw std::out_of_range("TrayColumn::at");
+    return values[i];
+  }
+  T&       operator[](size_t i)       {return values[i];}
+  const T& operator[](size_t i) const {return values[i];}
+
+  size_t         size()  const {return NROW*NCOL;}
+  T*             data()        {return values;}
+  const T*       data()  const {return values;}
+  iterator       begin()       {return values;}
+  iterator       end()         {return values + NROW*NCOL;}
+  const_iterator begin() const {return values;}
+  const_iterator end()   const {return values + NROW*NCOL;}
+
+  const uint64_t* Mask()            const {return valid_mask;}
+  bool            IsValid(size_t i) const {return (valid_mask[i >> 6] >> (i & 63)) & 1;}
+};// End of TrayColumn
+
+//========================================================================== Tray block
+
+// One aligned allocation holding all columns of a tray, followed by their validity masks.
+// Column slots [0, n_int_columns) hold ints, the remaining slots hold floats.
+// Everything starts as -999 (failed measurement or missing SiPM) and invalid.
+class TrayBlock {
+private:
+  void* memory;
+  int   n_int_columns;
+  int   n_columns;
+
+  // Not copyable: owns the allocation
+  TrayBlock(const TrayBlock&);
+  TrayBlock& operator=(const TrayBlock&);
+
+public:
+  TrayBlock(int n_int, int n_float) {
+    this->n_int_columns = n_int;
+    this->n_columns = n_int + n_float;
+    this->memory = NULL;
+    if (posix_memalign(&this->memory, tray_block_alignment, Bytes()) != 0) throw std::bad_alloc();
+    Reset();
+  }
+
+  ~TrayBlock() {free(this->memory);}
+
+  // Set every entry back to -999 and clear all validity bits
+  void Reset() {
+    memset(MaskData(), 0, MaskBytes());
+    for (int i_col = 0; i_col < n_columns; ++i_col) {
+      if (i_col < n_int_columns) {
+        int* column = IntColumn(i_col);
+        for (int i = 0; i < tray_column_stride; ++i) column[i] = -999;
+      } else {
+        float* column = FloatColumn(i_col);
+        for (int i = 0; i < tray_column_stride; ++i) column[i] = -999;
+      }
+    }
+  }
+
+  // Fill the validity masks from the column contents, once a tray has been parsed.
+  // An entry is valid unless it is -999 or NaN.
+  void BuildMasks() {
+    for (int i_col = 0; i_col < n_columns; ++i_col) BuildMask(i_col);
+  }
+
+  // Same for a single column, e.g. one filled from a second file after the rest
+  void BuildMask(int i_col) {
+    uint64_t* mask = Mask(i_col);
+    memset(mask, 0, tray_mask_words * sizeof(uint64_t));
+    for (int i = 0; i < NROW*NCOL; ++i) {
+      bool valid;
+      if (i_col < n_int_columns) valid = IntColumn(i_col)[i] != -999;
+      else {
+        float value = FloatColumn(i_col)[i];
+        valid = value != -999 && !std::isnan(value);
+      }mask[i >> 6] |= static_cast<uint64_t>(valid) << (i & 63);
+    }
+  }
+
+  int    GetNColumns()    const {return this->n_columns;}
+  int    GetNIntColumns() const {return this->n_int_columns;}
+  size_t ColumnBytes()    const {return static_cast<size_t>(n_columns) * tray_column_stride * 4;}
+  size_t MaskBytes()      const {return static_cast<size_t>(n_columns) * tray_mask_words * sizeof(uint64_t);}
+  size_t Bytes()          const {return ColumnBytes() + MaskBytes();}
+  char*  Data()                 {return static_cast<char*>(this->memory);}
+  char*  MaskData()             {return Data() + ColumnBytes();}
+
+  int*      IntColumn(int slot)   {return reinterpret_cast<int*>(Data() + static_cast<size_t>(slot) * tray_column_stride * 4);}
+  float*    FloatColumn(int slot) {return reinterpret_cast<float*>(Data() + static_cast<size_t>(slot) * tray_column_stride * 4);}
+  uint64_t* Mask(int slot)        {return reinterpret_cast<uint64_t*>(MaskData()) + static_cast<size_t>(slot) * tray_mask_words;}
+};// End of TrayBlock
+
+#endif /* SiPMTrayBlock_h */
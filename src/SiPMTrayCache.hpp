@@ -0,0 +1,180 @@
+//  *--
+//  SiPMTrayCache.hpp
+//
+//  Binary cache of parsed tray result files.
+//  Each text result file gets a "{file}.cache" next to it holding the
+//  parsed tray block, keyed by the source file's size, mtime and a hash of
+//  its contents. A cache whose key no longer matches is rebuilt by the
+//  reader on the next load.
+//  *--
+
+#ifndef SiPMTrayCache_h
+#define SiPMTrayCache_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SiPMTextParser.hpp"
+#include "SiPMTrayBlock.hpp"
+
+// Bump when the payload layout changes; old caches are then simply rebuilt
+const uint32_t tray_cache_version = 5;
+const char     tray_cache_magic[8] = {'S','i','P','M','T','C','H','\0'};
+
+//========================================================================== Cache key and payload
+
+// Fixed header at the start of every cache file
+struct TrayCacheHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t layout_tag;      // Identifies the file format and parse options the payload came from
+  uint64_t file_size;       // Source file size [bytes]
+  int64_t  file_mtime_ns;   // Source file modification time [ns since epoch]
+  uint64_t content_hash;    // FNV-1a hash of the full source file
+  uint32_t n_int_columns;
+  uint32_t n_columns;
+  uint32_t column_stride;   // Entries per column, including alignment padding
+  uint32_t note_length;     // Length of the tray note string that follows the header
+  uint32_t metadata_length; // Size of the per-tray metadata that follows the note
+};// structdef :: TrayCacheHeader
+
+// The parsed data of one tray: its note, optional fixed size metadata (e.g. the IV
+// parameter set) and the tray block, stored byte for byte
+struct TrayCacheColumns {
+  std::string* note;
+  TrayBlock*   block;
+  char*        metadata;          // NULL if the format has none
+  uint32_t     metadata_length;
+};// structdef :: TrayCacheColumns
+
+//========================================================================== Fingerprinting
+
+// 64-bit FNV-1a over a byte range
+inline uint64_t hashContent(const char* begin, const char* end) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char* c = begin; c != end; ++c) {
+    hash ^= static_cast<unsigned char>(*c);
+    hash *= 1099511628211ULL;
+  }return hash;
+}
+
+// Size and modification time of a file; returns false if it cannot be stat'ed
+inline bool statSourceFile(const char* filename, uint64_t& file_size, int64_t& file_mtime_ns) {
+  struct stat file_info;
+  if (stat(filename, &file_info) != 0) return false;
+  file_size = file_info.st_size;
+#ifdef __APPLE__
+  file_mtime_ns = static_cast<int64_t>(file_info.st_mtimespec.tv_sec)*1000000000LL + file_info.st_mtimespec.tv_nsec;
+#else
+  file_mtime_ns = static_cast<int64_t>(file_info.st_mtim.tv_sec)*1000000000LL + file_info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+inline std::string trayCachePath(const char* source_file) {
+  return std::string(source_file) + ".cache";
+}
+
+//========================================================================== Cache I/O
+
+// Read the payload that follows an already checked header into the tray block
+inline bool readTrayCachePayload(FILE* cache, const TrayCacheHeader& header, TrayCacheColumns& columns) {
+  std::vector<char> note(header.note_length);
+  if (header.note_length && fread(&note[0], 1, header.note_length, cache) != header.note_length) return false;
+  if (header.metadata_length != columns.metadata_length) return false;
+  if (header.metadata_length && fread(columns.metadata, 1, header.metadata_length, cache) != header.metadata_length) return false;
+  if (fread(columns.block->Data(), 1, columns.block->Bytes(), cache) != columns.block->Bytes()) {
+    columns.block->Reset(); // Truncated cache: do not leave a partial block behind for the parser
+    return false;
+  }
+  columns.note->assign(note.begin(), note.end());
+  return true;
+}
+
+// Write a cache file for source data described by key.
+// Written to a temporary file first and renamed, so readers never see a partial cache.
+// Returns false (and leaves no file) if the directory is not writable.
+inline bool saveTrayCache(const char* source_file, TrayCacheHeader key, const TrayCacheColumns& columns) {
+  std::string cache_file = trayCachePath(source_file);
+  char tmp_suffix[32];
+  snprintf(tmp_suffix, 32, ".tmp%d", static_cast<int>(getpid()));
+  std::string tmp_file = cache_file + tmp_suffix;
+
+  FILE* cache = fopen(tmp_file.c_str(), "wb");
+  if (!cache) return false;
+
+  // Built in zeroed storage so the padding bytes written with it are defined (reproducible cache files)
+  TrayCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  for (int i = 0; i < 8; ++i) header.magic[i] = tray_cache_magic[i];
+  header.version = tray_cache_version;
+  header.layout_tag = key.layout_tag;
+  header.file_size = key.file_size;
+  header.file_mtime_ns = key.file_mtime_ns;
+  header.content_hash = key.content_hash;
+  header.n_int_columns = columns.block->GetNIntColumns();
+  header.n_columns = columns.block->GetNColumns();
+  header.column_stride = tray_column_stride;
+  header.note_length = columns.note->size();
+  header.metadata_length = columns.metadata_length;
+
+  bool ok = fwrite(&header, sizeof(header), 1, cache) == 1;
+  if (ok && header.note_length) ok = fwrite(columns.note->data(), 1, header.note_length, cache) == header.note_length;
+  if (ok && header.metadata_length) ok = fwrite(columns.metadata, 1, header.metadata_length, cache) == header.metadata_length;
+  if (ok) ok = fwrite(columns.block->Data(), 1, columns.block->Bytes(), cache) == columns.block->Bytes();
+  ok = (fclose(cache) == 0) && ok;
+
+  if (ok) ok = rename(tmp_file.c_str(), cache_file.c_str()) == 0;
+  if (!ok) remove(tmp_file.c_str());
+  return ok;
+}// End of SiPMTrayCache::saveTrayCache
+
+// Fill columns from the cache of source_file if it is still valid.
+//   - Size and mtime match the stored key: load directly without touching the source.
+//   - Only the mtime differs (copied/touched file): hash the source, and if the
+//     content is unchanged load the cache and refresh its stored mtime.
+// Otherwise returns false; key then holds the source size/mtime (and hash if
+// it was computed) for the rebuilt cache.
+inline bool loadTrayCache(const char* source_file, uint32_t layout_tag, TrayCacheColumns& columns, TrayCacheHeader& key) {
+  key.layout_tag = layout_tag;
+  key.content_hash = 0;
+  if (!statSourceFile(source_file, key.file_size, key.file_mtime_ns)) return false;
+
+  std::string cache_file = trayCachePath(source_file);
+  FILE* cache = fopen(cache_file.c_str(), "rb");
+  if (!cache) return false;
+
+  TrayCacheHeader header;
+  bool usable = fread(&header, sizeof(header), 1, cache) == 1
+             && std::string(header.magic, 8) == std::string(tray_cache_magic, 8)
+             && header.version == tray_cache_version
+             && header.layout_tag == layout_tag
+             && header.n_int_columns == static_cast<uint32_t>(columns.block->GetNIntColumns())
+             && header.n_columns == static_cast<uint32_t>(columns.block->GetNColumns())
+             && header.column_stride == static_cast<uint32_t>(tray_column_stride)
+             && header.file_size == key.file_size;
+  if (!usable) {fclose(cache); return false;}
+
+  // Fast path: source untouched since the cache was written
+  if (header.file_mtime_ns == key.file_mtime_ns) {
+    key.content_hash = header.content_hash;
+    bool loaded = readTrayCachePayload(cache, header, columns);
+    fclose(cache);
+    return loaded;
+  }
+
+  // Same size, new mtime: decide on content
+  MappedTextFile source(source_file);
+  key.content_hash = hashContent(source.begin(), source.end());
+  bool loaded = key.content_hash == header.content_hash && readTrayCachePayload(cache, header, columns);
+  fclose(cache);
+  if (loaded) saveTrayCache(source_file, key, columns); // Store the new mtime so the next load takes the fast path
+  return loaded;
+}// End of SiPMTrayCache::loadTrayCache
+
+#endif /* SiPMTrayCache_h */
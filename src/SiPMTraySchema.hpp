@@ -0,0 +1,160 @@
+//  *--
+//  SiPMTraySchema.hpp
+//
+//  Compile-time description of the test stand text formats.
+//  A format lists, in file order, the tray block slot and type of every
+//  value column after the SiPM ID (see data/IV_HEADERS.txt and
+//  data/SPS_HEADERS.txt), plus how the ID and tray note are laid out.
+//  parseTrayText<Format> expands that list into a parser for exactly
+//  that layout, so nothing about the format is decided per line.
+//  A new stand firmware variant is a new format struct, not a new flag.
+//
+//  A format struct provides:
+//    typedef ... Data;                        IV_data or SPS_data
+//    static constexpr bool     has_header_line;      First line is not SiPM data; it is read by
+//                                                    static bool ParseHeader(line, line_end, Data&)
+//    static constexpr bool     leading_note_token;   A TRAYID+NOTE token precedes the SiPM ID
+//    static constexpr int      n_id_trailing_fields; Extra "_x" fields after the SiPM indices
+//    static constexpr uint32_t cache_layout;         Tray cache layout tag (see SiPMTrayCache.hpp)
+//    typedef FieldList<Field<...>, ...> Fields;      Value columns after the SiPM ID
+//  *--
+
+#ifndef SiPMTraySchema_h
+#define SiPMTraySchema_h
+
+#include <cmath>
+#include <string>
+#include <type_traits>
+
+#include "SiPMParseDiagnostics.hpp"
+#include "SiPMTextParser.hpp"
+#include "SiPMTrayBlock.hpp"
+
+// Per-field options
+enum FieldFlags {
+  kFieldStopOnNaN = 1 << 0    // A NaN ends the line: this and the following columns stay -999
+};
+
+// Outcome of reading one field
+enum FieldStatus {
+  kFieldOk,
+  kFieldStop,       // Expected end of the line (kFieldStopOnNaN), not an issue
+  kFieldMissing,    // No token left on the line
+  kFieldMalformed   // Token is not a number
+};
+
+//========================================================================== Fields
+
+// One whitespace separated value column stored in tray block slot Slot
+template <int Slot, typename T, unsigned Flags = 0>
+struct Field {
+  static_assert(std::is_same<T, int>::value || std::is_same<T, float>::value, "Tray columns hold int or float");
+
+  // Does the slot hold this field's type? (int slots come first in a TrayBlock)
+  static constexpr bool MatchesSlotType(int n_int_columns) {return std::is_same<T, int>::value == (Slot < n_int_columns);}
+
+  // Parse the next token into the column. On failure the token (if any) is left in [tok_begin, tok_end).
+  static FieldStatus Parse(const char*& cursor, const char* line_end, TrayBlock& block, int index,
+                           const char*& tok_begin, const char*& tok_end) {
+    T value;
+    if (!nextToken(cursor, line_end, tok_begin, tok_end)) return kFieldMissing;
+    if constexpr (std::is_same<T, int>::value) {
+      if (!tokenToInt(tok_begin, tok_end, value)) return kFieldMalformed;
+      block.IntColumn(Slot)[index] = value;
+    } else {
+      if (!tokenToFloat(tok_begin, tok_end, value)) return kFieldMalformed;
+      if constexpr ((Flags & kFieldStopOnNaN) != 0) {
+        if (std::isnan(value)) return kFieldStop;
+      }
+      block.FloatColumn(Slot)[index] = value;
+    }
+    return kFieldOk;
+  }
+};// structdef :: Field
+
+// The value columns of a line, in file order.
+// Parsing stops at the first field that fails; columns already read are kept.
+template <typename... Fields>
+struct FieldList {
+  static constexpr int size = sizeof...(Fields);
+
+  static constexpr bool MatchesSlotTypes(int n_int_columns) {return (Fields::MatchesSlotType(n_int_columns) && ...);}
+
+  // Returns kFieldOk if every field was read, otherwise the status of the field that
+  // stopped the line, whose position is left in n_read (and its token in tok_begin/tok_end)
+  static FieldStatus Parse(const char*& cursor, const char* line_end, TrayBlock& block, int index,
+                           int& n_read, const char*& tok_begin, const char*& tok_end) {
+    FieldStatus status = kFieldOk;
+    n_read = 0;
+    (((status = Fields::Parse(cursor, line_end, block, index, tok_begin, tok_end)) == kFieldOk && ++n_read) && ...);
+    return status;
+  }
+};// structdef :: FieldList
+
+//========================================================================== Parser
+
+// Parse a whole result file laid out as Format into data.
+// Never throws on bad input: lines that cannot be used are skipped and noted in issues,
+// and a line cut short keeps the columns read before the problem.
+// on_SiPM(flattened_index, row, col) is called for every line whose columns were all read
+// (used for the per-SiPM printout). Lines ended early by a NaN (kFieldStopOnNaN) or with
+// missing/malformed fields are skipped there, as the original reader dropped them.
+template <class Format, class OnSiPM>
+void parseTrayText(const char* file_begin, const char* file_end, typename Format::Data* data, ParseIssueList& issues, OnSiPM on_SiPM) {
+  typedef typename Format::Data Data;
+  static_assert(Format::Fields::MatchesSlotTypes(Data::kNIntColumns), "Format field types do not match the tray block slots");
+
+  const char* cursor = file_begin;
+  int line_number = 0;
+  if constexpr (Format::has_header_line) {
+    const char* header = cursor;
+    const char* header_end = nextLine(cursor, file_end);
+    ++line_number;
+    if (!Format::ParseHeader(header, header_end, *data)) issues.Add(line_number, kIssueBadHeader);
+  }
+  bool first_line = true;
+  while (cursor < file_end) {
+    const char* line = cursor;
+    const char* line_end = nextLine(cursor, file_end);
+    const char *tok_begin, *tok_end;
+    ++line_number;
+
+    // Blank lines (e.g. at the end of the file) are not issues
+    if (!nextToken(line, line_end, tok_begin, tok_end)) continue;
+
+    // Tray identifier and note: a leading token, or the part of the SiPM ID before its indices
+    if constexpr (Format::leading_note_token) {
+      if (first_line) data->tray_note.assign(tok_begin, tok_end);
+      if (!nextToken(line, line_end, tok_begin, tok_end)) {issues.Add(line_number, kIssueBadSiPMID); continue;}
+    }
+
+    // SiPM ID: the last two underscore separated fields (before any trailing ones) are the indices
+    int ccol, crow;
+    const char* id_prefix_end;
+    if (!splitSiPMIndex(tok_begin, tok_end, Format::n_id_trailing_fields, ccol, crow, &id_prefix_end)) {
+      issues.Add(line_number, kIssueBadSiPMID, -1, tok_begin, tok_end);
+      continue;
+    }
+    // Each index on its own: a column past NCOL would otherwise land in another SiPM's slot
+    if (crow < 0 || ccol < 0 || crow >= NROW || ccol >= NCOL) {
+      issues.Add(line_number, kIssueIndexOutOfRange, -1, tok_begin, tok_end);
+      continue;
+    }
+    int flattened_index = crow*NCOL + ccol;
+    if (data->row[flattened_index] != -999) issues.Add(line_number, kIssueDuplicateSiPM, -1, tok_begin, tok_end);
+    data->row[flattened_index] = crow;
+    data->col[flattened_index] = ccol;
+    if constexpr (!Format::leading_note_token) {
+      if (first_line) data->tray_note.assign(tok_begin, id_prefix_end);
+    }
+    first_line = false;
+
+    int n_read;
+    FieldStatus status = Format::Fields::Parse(line, line_end, data->block, flattened_index, n_read, tok_begin, tok_end);
+    if      (status == kFieldMissing)   issues.Add(line_number, kIssueMissingField, n_read);
+    else if (status == kFieldMalformed) issues.Add(line_number, kIssueBadField, n_read, tok_begin, tok_end);
+    if (status == kFieldOk) on_SiPM(flattened_index, crow, ccol);
+  }// End of processing current SiPM line
+}// End of SiPMTraySchema::parseTrayText
+
+#endif /* SiPMTraySchema_h */
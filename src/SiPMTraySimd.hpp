@@ -0,0 +1,208 @@
+//  *--
+//  SiPMTraySimd.hpp
+//
+//  Vector versions of the masked tray column reductions of SiPMTrayStats.hpp
+//  (AVX2 on x86-64, NEON on AArch64). A padded column is a whole number of
+//  8-float (AVX2) or 4-float (NEON) blocks whose lanes are selected by the
+//  matching bits of the validity mask, so there is no remainder loop and no
+//  per-entry branch; blocks without valid entries are skipped.
+//  The level is picked once at run time (AVX2 only if the CPU has it);
+//  SiPMTrayStats.hpp dispatches to these or to its scalar kernels.
+//
+//  Agreement with the scalar kernels:
+//    counts (above a limit, outside a window) - identical; the comparisons are
+//      made in the same precision as the scalar code
+//    sums - accumulated in double in 4 (AVX2) or 2 (NEON) interleaved lanes
+//      instead of index order, so they can differ from the scalar sums in the
+//      last bits (relative difference ~1e-15 for tray columns)
+//  checks/check_tray_simd.cpp repeats this comparison on random columns.
+//
+//  Define SiPM_no_simd to build without the vector kernels.
+//  *--
+
+#ifndef SiPMTraySimd_h
+#define SiPMTraySimd_h
+
+#include <cstdint>
+
+#include "SiPMTrayBlock.hpp"
+
+// Compiler flag to only use the scalar kernels
+//#define SiPM_no_simd
+
+#if !defined(SiPM_no_simd) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SiPM_simd_avx2
+#include <immintrin.h>
+#elif !defined(SiPM_no_simd) && defined(__aarch64__)
+#define SiPM_simd_neon
+#include <arm_neon.h>
+#endif
+
+static_assert(tray_column_stride % 8 == 0, "SIMD kernels read whole 8-float blocks");
+
+// Kernel set used by the masked reductions
+enum TraySimdLevel {
+  kSimdScalar,
+  kSimdAVX2,
+  kSimdNEON
+};
+
+inline TraySimdLevel detectTraySimdLevel() {
+#if defined(SiPM_simd_avx2)
+  return __builtin_cpu_supports("avx2") ? kSimdAVX2 : kSimdScalar;
+#elif defined(SiPM_simd_neon)
+  return kSimdNEON;  // Always present on AArch64
+#else
+  return kSimdScalar;
+#endif
+}
+
+// Level in use; set it to kSimdScalar to compare against the scalar kernels
+// (only lower it: a level the CPU lacks is not checked again)
+inline TraySimdLevel& traySimdLevel() {
+  static TraySimdLevel level = detectTraySimdLevel();
+  return level;
+}
+
+// Validity bits of entries [i, i+8) (i a multiple of 8)
+inline unsigned maskByte(const uint64_t* mask, int i) {return (mask[i >> 6] >> (i & 63)) & 0xFF;}
+
+//========================================================================== AVX2
+
+#if defined(SiPM_simd_avx2)
+
+// 64-bit lane masks (all ones where valid) for the 4 entries of a nibble
+__attribute__((target("avx2"))) inline __m256d laneMask4(unsigned nibble) {
+  const __m256i bit = _mm256_setr_epi64x(1, 2, 4, 8);
+  return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(nibble), bit), bit));
+}
+
+__attribute__((target("avx2"))) inline double horizontalSum(__m256d v) {
+  __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+__attribute__((target("avx2"))) inline double maskedSumAVX2(const float* values, const uint64_t* mask) {
+  __m256d sum = _mm256_setzero_pd();
+  for (int i = 0; i < tray_column_stride; i += 8) {
+    unsigned bits = maskByte(mask, i);
+    if (!bits) continue;  // Whole block invalid (padding, missing SiPMs)
+    __m256 block = _mm256_loadu_ps(values + i);
+    sum = _mm256_add_pd(sum, _mm256_and_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(block)), laneMask4(bits & 0xF)));
+    sum = _mm256_add_pd(sum, _mm256_and_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(block, 1)), laneMask4(bits >> 4)));
+  }return horizontalSum(sum);
+}
+
+__attribute__((target("avx2"))) inline double maskedSumSquaredDeviationAVX2(const float* values, const uint64_t* mask, double center) {
+  const __m256d c = _mm256_set1_pd(center);
+  __m256d sum = _mm256_setzero_pd();
+  for (int i = 0; i < tray_column_stride; i += 8) {
+    unsigned bits = maskByte(mask, i);
+    if (!bits) continue;
+    __m256 block = _mm256_loadu_ps(values + i);
+    __m256d low  = _mm256_and_pd(_mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(block)), c), laneMask4(bits & 0xF));
+    __m256d high = _mm256_and_pd(_mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(block, 1)), c), laneMask4(bits >> 4));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(low, low));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(high, high));
+  }return horizontalSum(sum);
+}
+
+__attribute__((target("avx2"))) inline int maskedCountAboveAVX2(const float* values, const uint64_t* mask, float limit) {
+  const __m256 l = _mm256_set1_ps(limit);
+  int count = 0;
+  for (int i = 0; i < tray_column_stride; i += 8) {
+    unsigned above = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), l, _CMP_GT_OQ));
+    count += __builtin_popcount(above & maskByte(mask, i));
+  }return count;
+}
+
+// |x - center| >= half_width in double, as in the scalar kernel
+__attribute__((target("avx2"))) inline int maskedCountOutsideAVX2(const float* values, const uint64_t* mask, double center, double half_width) {
+  const __m256d c = _mm256_set1_pd(center);
+  const __m256d w = _mm256_set1_pd(half_width);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  int count = 0;
+  for (int i = 0; i < tray_column_stride; i += 8) {
+    unsigned bits = maskByte(mask, i);
+    if (!bits) continue;
+    __m256 block = _mm256_loadu_ps(values + i);
+    __m256d low  = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(block)), c));
+    __m256d high = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(block, 1)), c));
+    unsigned outside = _mm256_movemask_pd(_mm256_cmp_pd(low, w, _CMP_GE_OQ))
+                     | _mm256_movemask_pd(_mm256_cmp_pd(high, w, _CMP_GE_OQ)) << 4;
+    count += __builtin_popcount(outside & bits);
+  }return count;
+}
+
+#endif /* SiPM_simd_avx2 */
+
+//========================================================================== NEON
+
+#if defined(SiPM_simd_neon)
+
+// 64-bit lane masks for 2 entries, 32-bit lane masks for 4 entries
+inline uint64x2_t laneMask2(unsigned pair) {
+  const uint64_t bit_values[2] = {1, 2};
+  return vtstq_u64(vdupq_n_u64(pair), vld1q_u64(bit_values));
+}
+inline uint32x4_t laneMask4(unsigned nibble) {
+  const uint32_t bit_values[4] = {1, 2, 4, 8};
+  return vtstq_u32(vdupq_n_u32(nibble), vld1q_u32(bit_values));
+}
+
+inline float64x2_t maskedLanes(float64x2_t v, uint64x2_t lanes) {
+  return vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(v), lanes));
+}
+
+inline double maskedSumNEON(const float* values, const uint64_t* mask) {
+  float64x2_t sum = vdupq_n_f64(0);
+  for (int i = 0; i < tray_column_stride; i += 4) {
+    unsigned bits = (mask[i >> 6] >> (i & 63)) & 0xF;
+    if (!bits) continue;
+    float32x4_t block = vld1q_f32(values + i);
+    sum = vaddq_f64(sum, maskedLanes(vcvt_f64_f32(vget_low_f32(block)), laneMask2(bits & 0x3)));
+    sum = vaddq_f64(sum, maskedLanes(vcvt_high_f64_f32(block), laneMask2(bits >> 2)));
+  }return vaddvq_f64(sum);
+}
+
+inline double maskedSumSquaredDeviationNEON(const float* values, const uint64_t* mask, double center) {
+  const float64x2_t c = vdupq_n_f64(center);
+  float64x2_t sum = vdupq_n_f64(0);
+  for (int i = 0; i < tray_column_stride; i += 4) {
+    unsigned bits = (mask[i >> 6] >> (i & 63)) & 0xF;
+    if (!bits) continue;
+    float32x4_t block = vld1q_f32(values + i);
+    float64x2_t low  = maskedLanes(vsubq_f64(vcvt_f64_f32(vget_low_f32(block)), c), laneMask2(bits & 0x3));
+    float64x2_t high = maskedLanes(vsubq_f64(vcvt_high_f64_f32(block), c), laneMask2(bits >> 2));
+    sum = vfmaq_f64(sum, low, low);
+    sum = vfmaq_f64(sum, high, high);
+  }return vaddvq_f64(sum);
+}
+
+inline int maskedCountAboveNEON(const float* values, const uint64_t* mask, float limit) {
+  const float32x4_t l = vdupq_n_f32(limit);
+  uint32x4_t count = vdupq_n_u32(0);
+  for (int i = 0; i < tray_column_stride; i += 4) {
+    uint32x4_t above = vandq_u32(vcgtq_f32(vld1q_f32(values + i), l), laneMask4((mask[i >> 6] >> (i & 63)) & 0xF));
+    count = vsubq_u32(count, above);  // All-ones lanes count as -1
+  }return vaddvq_u32(count);
+}
+
+inline int maskedCountOutsideNEON(const float* values, const uint64_t* mask, double center, double half_width) {
+  const float64x2_t c = vdupq_n_f64(center);
+  const float64x2_t w = vdupq_n_f64(half_width);
+  uint64x2_t count = vdupq_n_u64(0);
+  for (int i = 0; i < tray_column_stride; i += 4) {
+    unsigned bits = (mask[i >> 6] >> (i & 63)) & 0xF;
+    if (!bits) continue;
+    float32x4_t block = vld1q_f32(values + i);
+    uint64x2_t low  = vcgeq_f64(vabdq_f64(vcvt_f64_f32(vget_low_f32(block)), c), w);
+    uint64x2_t high = vcgeq_f64(vabdq_f64(vcvt_high_f64_f32(block), c), w);
+    count = vsubq_u64(count, vandq_u64(low, laneMask2(bits & 0x3)));
+    count = vsubq_u64(count, vandq_u64(high, laneMask2(bits >> 2)));
+  }return vaddvq_u64(count);
+}
+
+#endif /* SiPM_simd_neon */
+
+#endif /* SiPMTraySimd_h */
@@ -0,0 +1,277 @@
+//  *--
+//  SiPMTrayStats.hpp
+//
+//  Masked reduction primitives over a single tray column.
+//  Only entries whose validity bit is set (see TrayBlock::BuildMasks)
+//  take part, so no -999/NaN comparisons are needed in the loops.
+//  Invalid entries are removed with a select rather than a branch,
+//  which keeps the inner loops free of data-dependent jumps.
+//  maskedMoments gives count, mean, variance, min and max in one pass.
+//  The robust statistics (median, MAD, quantiles, trimmed mean) copy the
+//  valid entries to a scratch buffer and use selection (std::nth_element,
+//  O(N)) instead of a full sort.
+//  The sum, deviation and counting reductions dispatch to the vector
+//  kernels of SiPMTraySimd.hpp when the CPU has them; the scalar kernels
+//  below are the reference and the fallback.
+//  *--
+
+#ifndef SiPMTrayStats_h
+#define SiPMTrayStats_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "SiPMTrayBlock.hpp"
+#include "SiPMTraySimd.hpp"
+
+// Summary of the valid entries of a column (see maskedMoments)
+struct MaskedMoments {
+  int    n;
+  double mean;                   // NaN if n == 0
+  double sum_squared_deviation;  // sum (x - mean)^2; variance is this over n (population) or n-1
+  float  min;                    // +inf/-inf if n == 0
+  float  max;
+
+  double Variance() const {return sum_squared_deviation / static_cast<double>(n);}
+
+  // Fold in the moments of another set of entries (Chan et al. pairwise update)
+  void Merge(const MaskedMoments& other) {
+    if (other.n == 0) return;
+    if (n == 0) {*this = other; return;}
+    int    n_total = n + other.n;
+    double delta = other.mean - mean;
+    mean += delta * other.n / n_total;
+    sum_squared_deviation += other.sum_squared_deviation + delta*delta * (static_cast<double>(n) * other.n / n_total);
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    n = n_total;
+  }
+};// structdef :: MaskedMoments
+
+// Median and median absolute deviation of the valid entries of a column (see maskedMedianMAD)
+struct MaskedRobust {
+  int    n;
+  double median;  // NaN if n == 0
+  double mad;     // median |x - median|; times 1.4826 estimates the standard deviation of normal data
+};// structdef :: MaskedRobust
+
+//========================================================================== Scalar kernels
+
+// Number of valid entries in a column
+inline int maskedCount(const uint64_t* mask) {
+  int count = 0;
+  for (int w = 0; w < tray_mask_words; ++w) count += __builtin_popcountll(mask[w]);
+  return count;
+}
+
+// Sum of the valid entries (accumulated in double, in index order)
+inline double maskedSumScalar(const float* values, const uint64_t* mask) {
+  double sum = 0;
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    int n_in_word = std::min(64, tray_column_stride - 64*w);
+    for (int j = 0; j < n_in_word; ++j) sum += ((bits >> j) & 1) ? static_cast<double>(word_values[j]) : 0.;
+  }return sum;
+}
+
+// Sum of squared deviations of the valid entries from center
+inline double maskedSumSquaredDeviationScalar(const float* values, const uint64_t* mask, double center) {
+  double sum = 0;
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    int n_in_word = std::min(64, tray_column_stride - 64*w);
+    for (int j = 0; j < n_in_word; ++j) {
+      double deviation = ((bits >> j) & 1) ? word_values[j] - center : 0.;
+      sum += deviation*deviation;
+    }
+  }return sum;
+}
+
+// Number of valid entries strictly above limit
+inline int maskedCountAboveScalar(const float* values, const uint64_t* mask, float limit) {
+  int count = 0;
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    int n_in_word = std::min(64, tray_column_stride - 64*w);
+    for (int j = 0; j < n_in_word; ++j) count += static_cast<int>((bits >> j) & 1) & static_cast<int>(word_values[j] > limit);
+  }return count;
+}
+
+// Number of valid entries with |x - center| >= half_width (outliers)
+inline int maskedCountOutsideScalar(const float* values, const uint64_t* mask, double center, double half_width) {
+  int count = 0;
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    int n_in_word = std::min(64, tray_column_stride - 64*w);
+    for (int j = 0; j < n_in_word; ++j) count += static_cast<int>((bits >> j) & 1) & static_cast<int>(std::fabs(word_values[j] - center) >= half_width);
+  }return count;
+}
+
+//========================================================================== Masked primitives
+
+inline double maskedSum(const float* values, const uint64_t* mask) {
+  switch (traySimdLevel()) {
+#if defined(SiPM_simd_avx2)
+    case kSimdAVX2: return maskedSumAVX2(values, mask);
+#elif defined(SiPM_simd_neon)
+    case kSimdNEON: return maskedSumNEON(values, mask);
+#endif
+    default:        return maskedSumScalar(values, mask);
+  }
+}
+
+inline double maskedSumSquaredDeviation(const float* values, const uint64_t* mask, double center) {
+  switch (traySimdLevel()) {
+#if defined(SiPM_simd_avx2)
+    case kSimdAVX2: return maskedSumSquaredDeviationAVX2(values, mask, center);
+#elif defined(SiPM_simd_neon)
+    case kSimdNEON: return maskedSumSquaredDeviationNEON(values, mask, center);
+#endif
+    default:        return maskedSumSquaredDeviationScalar(values, mask, center);
+  }
+}
+
+inline int maskedCountAbove(const float* values, const uint64_t* mask, float limit) {
+  switch (traySimdLevel()) {
+#if defined(SiPM_simd_avx2)
+    case kSimdAVX2: return maskedCountAboveAVX2(values, mask, limit);
+#elif defined(SiPM_simd_neon)
+    case kSimdNEON: return maskedCountAboveNEON(values, mask, limit);
+#endif
+    default:        return maskedCountAboveScalar(values, mask, limit);
+  }
+}
+
+inline int maskedCountOutside(const float* values, const uint64_t* mask, double center, double half_width) {
+  switch (traySimdLevel()) {
+#if defined(SiPM_simd_avx2)
+    case kSimdAVX2: return maskedCountOutsideAVX2(values, mask, center, half_width);
+#elif defined(SiPM_simd_neon)
+    case kSimdNEON: return maskedCountOutsideNEON(values, mask, center, half_width);
+#endif
+    default:        return maskedCountOutsideScalar(values, mask, center, half_width);
+  }
+}
+
+// Count, mean, sum of squared deviations, min and max of the valid entries in one pass.
+// Welford's update keeps the deviations accurate without a second pass over the column.
+// Only the set bits are visited, so invalid entries cost nothing.
+inline MaskedMoments maskedMoments(const float* values, const uint64_t* mask) {
+  MaskedMoments moments;
+  moments.n = 0;
+  moments.mean = 0;
+  moments.sum_squared_deviation = 0;
+  moments.min = std::numeric_limits<float>::infinity();
+  moments.max = -std::numeric_limits<float>::infinity();
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    while (bits) {
+      float value = word_values[__builtin_ctzll(bits)];
+      bits &= bits - 1;
+      double delta = value - moments.mean;
+      moments.mean += delta / ++moments.n;
+      moments.sum_squared_deviation += delta * (value - moments.mean);
+      moments.min = std::min(moments.min, value);
+      moments.max = std::max(moments.max, value);
+    }
+  }
+  if (moments.n == 0) moments.mean = NAN;
+  return moments;
+}
+
+//========================================================================== Robust statistics
+
+// Copy the valid entries of a column to out (room for tray_column_stride floats), return their number
+inline int maskedGather(const float* values, const uint64_t* mask, float* out) {
+  int n = 0;
+  for (int w = 0; w < tray_mask_words; ++w) {
+    uint64_t bits = mask[w];
+    const float* word_values = values + 64*w;
+    while (bits) {
+      out[n++] = word_values[__builtin_ctzll(bits)];
+      bits &= bits - 1;
+    }
+  }return n;
+}
+
+// The select* functions work on n values in a scratch buffer, which they reorder.
+
+// q-quantile (0 <= q <= 1), interpolated linearly between the neighbouring order statistics
+// (the default of R and numpy). NaN if n == 0.
+inline double selectQuantile(float* buffer, int n, double q) {
+  if (n <= 0) return NAN;
+  double position = std::min(1.0, std::max(0.0, q)) * (n - 1);
+  int lower = static_cast<int>(position);
+  std::nth_element(buffer, buffer + lower, buffer + n);
+  double value = buffer[lower];
+  if (position > lower) value += (position - lower) * (*std::min_element(buffer + lower + 1, buffer + n) - value);
+  return value;
+}
+
+// Median absolute deviation about center (the buffer is overwritten with the deviations)
+inline double selectMAD(float* buffer, int n, double center) {
+  for (int i = 0; i < n; ++i) buffer[i] = std::fabs(buffer[i] - center);
+  return selectQuantile(buffer, n, 0.5);
+}
+
+// Mean after dropping floor(trim_fraction * n) values at each end (trim_fraction in [0, 0.5);
+// at least one value is kept). NaN if n == 0.
+inline double selectTrimmedMean(float* buffer, int n, double trim_fraction) {
+  if (n <= 0) return NAN;
+  int cut = static_cast<int>(std::max(0.0, trim_fraction) * n);
+  cut = std::min(cut, (n - 1) / 2);
+  if (cut > 0) {
+    std::nth_element(buffer, buffer + cut, buffer + n);                // Lowest cut values in front
+    std::nth_element(buffer + cut, buffer + n - cut - 1, buffer + n);  // Highest cut values at the back
+  }
+  double sum = 0;
+  for (int i = cut; i < n - cut; ++i) sum += buffer[i];
+  return sum / (n - 2*cut);
+}
+
+inline double maskedQuantile(const float* values, const uint64_t* mask, double q) {
+  float scratch[tray_column_stride];
+  return selectQuantile(scratch, maskedGather(values, mask, scratch), q);
+}
+
+inline double maskedTrimmedMean(const float* values, const uint64_t* mask, double trim_fraction) {
+  float scratch[tray_column_stride];
+  return selectTrimmedMean(scratch, maskedGather(values, mask, scratch), trim_fraction);
+}
+
+// Median and MAD in two selections over one gathered copy
+inline MaskedRobust maskedMedianMAD(const float* values, const uint64_t* mask) {
+  float scratch[tray_column_stride];
+  MaskedRobust robust;
+  robust.n = maskedGather(values, mask, scratch);
+  robust.median = selectQuantile(scratch, robust.n, 0.5);
+  robust.mad = selectMAD(scratch, robust.n, robust.median);
+  return robust;
+}
+
+//========================================================================== Column overloads
+
+inline int    maskedCount(const TrayColumn<float>& column)                    {return maskedCount(column.Mask());}
+inline double maskedSum(const TrayColumn<float>& column)                      {return maskedSum(column.data(), column.Mask());}
+inline double maskedSumSquaredDeviation(const TrayColumn<float>& column, double center) {
+  return maskedSumSquaredDeviation(column.data(), column.Mask(), center);
+}
+inline MaskedMoments maskedMoments(const TrayColumn<float>& column)           {return maskedMoments(column.data(), column.Mask());}
+inline int    maskedCountAbove(const TrayColumn<float>& column, float limit)  {return maskedCountAbove(column.data(), column.Mask(), limit);}
+inline int    maskedCountOutside(const TrayColumn<float>& column, double center, double half_width) {
+  return maskedCountOutside(column.data(), column.Mask(), center, half_width);
+}
+inline double maskedQuantile(const TrayColumn<float>& column, double q)       {return maskedQuantile(column.data(), column.Mask(), q);}
+inline double maskedTrimmedMean(const TrayColumn<float>& column, double trim_fraction) {
+  return maskedTrimmedMean(column.data(), column.Mask(), trim_fraction);
+}
+inline MaskedRobust maskedMedianMAD(const TrayColumn<float>& column)           {return maskedMedianMAD(column.data(), column.Mask());}
+
+#endif /* SiPMTrayStats_h */
@@ -0,0 +1,196 @@
+//  *--
+//  SiPMTrayWatcher.hpp
+//
+//  Watches a data directory for tray result directories written by the
+//  test stand while it runs. A result directory is reported once both
+//  required files exist and have not changed for a settle time, so a
+//  tray is never picked up half written.
+//  On Linux inotify wakes the watcher as soon as something changes; the
+//  directory is also rescanned on a timer, which is the only mechanism
+//  elsewhere and on network shares where inotify sees no remote writes.
+//  *--
+
+#ifndef SiPMTrayWatcher_h
+#define SiPMTrayWatcher_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <map>
+#include <poll.h>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "SiPMTrayCache.hpp"
+
+//========================================================================== TrayResultWatcher
+
+class TrayResultWatcher {
+private:
+  // Required files of a result directory as last seen
+  struct ResultSnapshot {
+    uint64_t file_size[2];
+    int64_t  file_mtime_ns[2];
+    int64_t  unchanged_since_ms;  // When this size/mtime was first seen
+  };// structdef :: ResultSnapshot
+
+  std::string data_dir;
+  bool        has_subscript_results;
+  int         settle_ms;          // Files must be unchanged this long before a directory is reported
+  int         rescan_ms;          // Rescan period (safety net with inotify, the only mechanism without)
+  int         inotify_fd;         // -1 when polling
+
+  std::set<std::string>                 reported;   // Result directories already handed out
+  std::map<std::string, ResultSnapshot> pending;    // Result directories seen but not yet settled
+  std::map<std::string, int>            watches;    // inotify watch descriptors of pending directories
+
+  static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Does this directory name follow the result directory convention?
+  bool IsResultDirectory(const std::string& name) const {
+    if (name.empty() || name[0] == '.') return false;
+    if (!this->has_subscript_results) return true;
+    return name.size() > 8 && name.compare(name.size() - 8, 8, "-results") == 0;
+  }
+
+  // Tray identifier of a result directory: {tray}[-robot][-results] -> {tray}
+  std::string TrayOf(std::string name) const {
+    if (this->has_subscript_results) name.erase(name.size() - 8);
+    if (name.size() > 6 && name.compare(name.size() - 6, 6, "-robot") == 0) name.erase(name.size() - 6);
+    return name;
+  }
+
+  void WatchDirectory(const std::string& name) {
+#ifdef __linux__
+    if (this->inotify_fd < 0 || this->watches.count(name)) return;
+    int wd = inotify_add_watch(this->inotify_fd, (this->data_dir + "/" + name).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd >= 0) this->watches[name] = wd;
+#endif
+  }
+
+  void UnwatchDirectory(const std::string& name) {
+#ifdef __linux__
+    std::map<std::string, int>::iterator it = this->watches.find(name);
+    if (it == this->watches.end()) return;
+    inotify_rm_watch(this->inotify_fd, it->second);
+    this->watches.erase(it);
+#endif
+  }
+
+  // Drain pending inotify events; their content does not matter since the directory is rescanned
+  void DrainEvents() {
+#ifdef __linux__
+    char buffer[4096];
+    while (read(this->inotify_fd, buffer, sizeof(buffer)) > 0) continue;
+#endif
+  }
+
+  // List the data directory and move result directories along pending -> reported.
+  // With settle_now, complete directories are reported without waiting (initial scan).
+  void Scan(std::vector<std::string>& finished, bool settle_now) {
+    DIR* dir = opendir(this->data_dir.c_str());
+    if (!dir) return;
+    int64_t now = NowMs();
+    while (struct dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (!IsResultDirectory(name) || this->reported.count(name)) continue;
+      std::string path = this->data_dir + "/" + name;
+      struct stat info;
+      if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) continue;
+      WatchDirectory(name);
+
+      // Both required files present?
+      ResultSnapshot snapshot;
+      bool complete = statSourceFile((path + "/IV_result.txt").c_str(), snapshot.file_size[0], snapshot.file_mtime_ns[0])
+                   && statSourceFile((path + "/SPS_result_onlynumbers.txt").c_str(), snapshot.file_size[1], snapshot.file_mtime_ns[1]);
+      if (!complete) {this->pending.erase(name); continue;}
+
+      // Still being written if anything changed since the last scan
+      std::map<std::string, ResultSnapshot>::iterator last = this->pending.find(name);
+      bool unchanged = last != this->pending.end()
+                    && memcmp(last->second.file_size, snapshot.file_size, sizeof(snapshot.file_size)) == 0
+                    && memcmp(last->second.file_mtime_ns, snapshot.file_mtime_ns, sizeof(snapshot.file_mtime_ns)) == 0;
+      snapshot.unchanged_since_ms = unchanged ? last->second.unchanged_since_ms : now;
+      if (settle_now || (unchanged && now - snapshot.unchanged_since_ms >= this->settle_ms)) {
+        this->pending.erase(name);
+        this->reported.insert(name);
+        UnwatchDirectory(name);
+        finished.push_back(name);
+      } else this->pending[name] = snapshot;
+    }closedir(dir);
+  }// End of TrayResultWatcher::Scan
+
+  // Not copyable: owns the inotify descriptor
+  TrayResultWatcher(const TrayResultWatcher&);
+  TrayResultWatcher& operator=(const TrayResultWatcher&);
+
+public:
+  // Watch data_directory for {tray}[-robot][-results] directories.
+  // Unless report_existing is set, directories that are already complete when
+  // the watcher starts are treated as seen and never reported.
+  TrayResultWatcher(const std::string& data_directory, bool subscript_results = true,
+                    bool report_existing = false, int settle_seconds = 5, int rescan_seconds = 2) {
+    this->data_dir = data_directory;
+    this->has_subscript_results = subscript_results;
+    this->settle_ms = 1000*settle_seconds;
+    this->rescan_ms = 1000*rescan_seconds;
+    this->inotify_fd = -1;
+#ifdef __linux__
+    this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotify_fd >= 0 && inotify_add_watch(this->inotify_fd, data_directory.c_str(), IN_CREATE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+      close(this->inotify_fd);
+      this->inotify_fd = -1;
+    }
+#endif
+    if (!report_existing) {
+      std::vector<std::string> existing;
+      Scan(existing, true);
+    }
+  }
+
+  ~TrayResultWatcher() {if (this->inotify_fd >= 0) close(this->inotify_fd);}
+
+  // Block until at least one result directory has settled, or timeout_ms passes (< 0: no timeout).
+  // Returns the trays of the newly settled directories (a tray appears once even if
+  // its cassette and robot directories settle together).
+  std::vector<std::string> WaitForTrays(int timeout_ms = -1) {
+    std::vector<std::string> trays;
+    int64_t deadline = timeout_ms < 0 ? -1 : NowMs() + timeout_ms;
+    while (true) {
+      std::vector<std::string> finished;
+      Scan(finished, false);
+      for (std::vector<std::string>::iterator it = finished.begin(); it != finished.end(); ++it) {
+        std::string tray = TrayOf(*it);
+        if (std::find(trays.begin(), trays.end(), tray) == trays.end()) trays.push_back(tray);
+      }if (!trays.empty()) return trays;
+
+      // Sleep until the next rescan, a pending directory may have settled, or inotify fires
+      int64_t now = NowMs();
+      if (deadline >= 0 && now >= deadline) return trays;
+      int64_t wait_ms = this->rescan_ms;
+      for (std::map<std::string, ResultSnapshot>::iterator it = this->pending.begin(); it != this->pending.end(); ++it) {
+        wait_ms = std::min(wait_ms, std::max<int64_t>(it->second.unchanged_since_ms + this->settle_ms - now, 50));
+      }if (deadline >= 0) wait_ms = std::min(wait_ms, deadline - now);
+
+      if (this->inotify_fd >= 0) {
+        struct pollfd event_fd = {this->inotify_fd, POLLIN, 0};
+        if (poll(&event_fd, 1, static_cast<int>(wait_ms)) > 0) DrainEvents();
+      } else usleep(static_cast<useconds_t>(wait_ms)*1000);
+    }
+  }// End of TrayResultWatcher::WaitForTrays
+
+  bool               UsesInotify()   const {return this->inotify_fd >= 0;}
+  int                GetNPending()   const {return this->pending.size();}
+  const std::string& GetDataDir()    const {return this->data_dir;}
+};// End of TrayResultWatcher
+
+#endif /* SiPMTrayWatcher_h */
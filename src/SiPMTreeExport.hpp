@@ -0,0 +1,176 @@
+//  *--
+//  SiPMTreeExport.hpp
+//
+//  Export of the loaded dataset to a columnar ROOT file, so later studies
+//  can query it (TTree::Draw, RDataFrame, uproot) without the text files.
+//  Two trees are written:
+//    sipm - one entry per SiPM per tray entry, every IV and SPS quantity
+//    tray - one entry per tray entry, its note and IV parameter set
+//  Both carry tray and mode, so they can be joined on (tray, mode).
+//  Missing SiPMs and failed measurements keep the -999 convention.
+//
+//  Usage (after ReadDataIV/ReadDataSPS):
+//    writeSiPMTree("../data/production.root");
+//  *--
+
+#ifndef SiPMTreeExport_h
+#define SiPMTreeExport_h
+
+#include <string>
+
+#include "Compression.h"
+#include "TFile.h"
+#include "TTree.h"
+
+#include "global_vars.hpp"
+#include "SiPMDataReader.hpp"
+
+//========================================================================== Export
+
+// Write the IV and SPS data held by reader to filename (recreated).
+// Data types that have not been read are written as -999.
+// compression: ROOT compression setting (see ROOT::RCompressionSetting), general purpose by default
+// Returns false if the file cannot be written.
+bool writeSiPMTree(const char* filename, SiPMDataReader* reader = gReader,
+                   int compression = ROOT::RCompressionSetting::EDefaults::kUseGeneralPurpose) {
+  if (!reader) {
+    std::cout << t_red << "Error" << t_def << " in <SiPMTreeExport::writeSiPMTree>: no reader given." << std::endl;
+    return false;
+  }
+  TFile* outfile = TFile::Open(filename, "RECREATE", "", compression);
+  if (!outfile || outfile->IsZombie()) {
+    std::cout << t_red << "Error" << t_def << " in <SiPMTreeExport::writeSiPMTree>: could not create " << filename << std::endl;
+    delete outfile;
+    return false;
+  }
+
+  std::vector<std::string>* tray_strings = reader->GetTrayStrings();
+  std::vector<int>*         tray_modes   = reader->GetTrayModes();
+  std::vector<IV_data*>*    IV_trays     = reader->GetIV();
+  std::vector<SPS_data*>*   SPS_trays    = reader->GetSPS();
+  int n_trays = tray_strings->size();
+
+  // *---------------- Per-SiPM tree
+
+  // Identification
+  std::string tray;
+  Int_t mode, row, col, index, test_set, test_position;
+  Long64_t test_time;
+
+  // IV_result.txt
+  Float_t IV_avg_temp, IV_stdev_temp, IV_Vpeak, IV_Vpeak_25C, Idark_3below, Idark_4above, Idark_temp, forward_res;
+
+  // SPS_result_onlynumbers.txt (and SPS_result.txt)
+  Int_t   SPS_npeaks;
+  Float_t SPS_avg_temp, SPS_stdev_temp, SPS_peakwidth, SPS_Vbd, SPS_Vbd_25C, SPS_Vbd_unc, SPS_chi2ndf;
+  Float_t fit_parm_0, fit_parm_1, SPS_steepness_unc, SPS_gain;
+
+  TTree* sipm_tree = new TTree("sipm", "Per-SiPM IV and SPS results");
+  sipm_tree->Branch("tray", &tray);
+  sipm_tree->Branch("mode", &mode, "mode/I");                   // 0 cassette, 1 robot
+  sipm_tree->Branch("row", &row, "row/I");
+  sipm_tree->Branch("col", &col, "col/I");
+  sipm_tree->Branch("index", &index, "index/I");                // row*NCOL + col
+  sipm_tree->Branch("test_set", &test_set, "test_set/I");       // Cassette test index (set#, position)
+  sipm_tree->Branch("test_position", &test_position, "test_position/I");
+  sipm_tree->Branch("test_time", &test_time, "test_time/L");    // IV test start [Unix time, s]
+  sipm_tree->Branch("IV_avg_temp", &IV_avg_temp, "IV_avg_temp/F");
+  sipm_tree->Branch("IV_stdev_temp", &IV_stdev_temp, "IV_stdev_temp/F");
+  sipm_tree->Branch("IV_Vpeak", &IV_Vpeak, "IV_Vpeak/F");
+  sipm_tree->Branch("IV_Vpeak_25C", &IV_Vpeak_25C, "IV_Vpeak_25C/F");
+  sipm_tree->Branch("Idark_3below", &Idark_3below, "Idark_3below/F");
+  sipm_tree->Branch("Idark_4above", &Idark_4above, "Idark_4above/F");
+  sipm_tree->Branch("Idark_temp", &Idark_temp, "Idark_temp/F");
+  sipm_tree->Branch("forward_res", &forward_res, "forward_res/F");
+  sipm_tree->Branch("SPS_npeaks", &SPS_npeaks, "SPS_npeaks/I");
+  sipm_tree->Branch("SPS_avg_temp", &SPS_avg_temp, "SPS_avg_temp/F");
+  sipm_tree->Branch("SPS_stdev_temp", &SPS_stdev_temp, "SPS_stdev_temp/F");
+  sipm_tree->Branch("SPS_peakwidth", &SPS_peakwidth, "SPS_peakwidth/F");
+  sipm_tree->Branch("SPS_Vbd", &SPS_Vbd, "SPS_Vbd/F");
+  sipm_tree->Branch("SPS_Vbd_25C", &SPS_Vbd_25C, "SPS_Vbd_25C/F");
+  sipm_tree->Branch("SPS_Vbd_unc", &SPS_Vbd_unc, "SPS_Vbd_unc/F");
+  sipm_tree->Branch("SPS_chi2ndf", &SPS_chi2ndf, "SPS_chi2ndf/F");
+  sipm_tree->Branch("fit_parm_0", &fit_parm_0, "fit_parm_0/F");
+  sipm_tree->Branch("fit_parm_1", &fit_parm_1, "fit_parm_1/F");
+  sipm_tree->Branch("SPS_steepness_unc", &SPS_steepness_unc, "SPS_steepness_unc/F");
+  sipm_tree->Branch("SPS_gain", &SPS_gain, "SPS_gain/F");
+
+  for (int i_tray = 0; i_tray < n_trays; ++i_tray) {
+    IV_data*  IV  = i_tray < IV_trays->size()  ? IV_trays->at(i_tray)  : NULL;
+    SPS_data* SPS = i_tray < SPS_trays->size() ? SPS_trays->at(i_tray) : NULL;
+    tray = tray_strings->at(i_tray);
+    mode = tray_modes->at(i_tray);
+    test_time = IV ? IV->parameters.timestamp : -999;
+
+    for (int i = 0; i < NROW*NCOL; ++i) {
+      // Only SiPMs that appear in at least one of the files
+      bool in_IV  = IV  && IV->row[i]  != -999;
+      bool in_SPS = SPS && SPS->row[i] != -999;
+      if (!in_IV && !in_SPS) continue;
+
+      index = i;
+      row = i/NCOL;
+      col = i%NCOL;
+      test_set = i/32;
+      test_position = i%32;
+
+      IV_avg_temp   = in_IV ? IV->avg_temp[i]     : -999;
+      IV_stdev_temp = in_IV ? IV->stdev_temp[i]   : -999;
+      IV_Vpeak      = in_IV ? IV->IV_Vpeak[i]     : -999;
+      IV_Vpeak_25C  = in_IV ? IV->IV_Vpeak_25C[i] : -999;
+      Idark_3below  = in_IV ? IV->Idark_3below[i] : -999;
+      Idark_4above  = in_IV ? IV->Idark_4above[i] : -999;
+      Idark_temp    = in_IV ? IV->Idark_temp[i]   : -999;
+      forward_res   = in_IV ? IV->forward_res[i]  : -999;
+
+      SPS_npeaks        = in_SPS ? SPS->SPS_npeaks[i]        : -999;
+      SPS_avg_temp      = in_SPS ? SPS->avg_temp[i]          : -999;
+      SPS_stdev_temp    = in_SPS ? SPS->stdev_temp[i]        : -999;
+      SPS_peakwidth     = in_SPS ? SPS->SPS_peakwidth[i]     : -999;
+      SPS_Vbd           = in_SPS ? SPS->SPS_Vbd[i]           : -999;
+      SPS_Vbd_25C       = in_SPS ? SPS->SPS_Vbd_25C[i]       : -999;
+      SPS_Vbd_unc       = in_SPS ? SPS->SPS_Vbd_unc[i]       : -999;
+      SPS_chi2ndf       = in_SPS ? SPS->SPS_chi2ndf[i]       : -999;
+      fit_parm_0        = in_SPS ? SPS->fit_parm_0[i]        : -999;
+      fit_parm_1        = in_SPS ? SPS->fit_parm_1[i]        : -999;
+      SPS_steepness_unc = in_SPS ? SPS->SPS_steepness_unc[i] : -999;
+      SPS_gain          = in_SPS ? SPS->SPS_gain[i]          : -999;
+
+      sipm_tree->Fill();
+    }// End of SiPM loop
+  }// End of tray loop
+
+  // *---------------- Per-tray tree
+
+  std::string tray_note;
+  Int_t   n_settings;
+  Float_t settings[IV_parameter_set::kMaxSettings];
+
+  TTree* tray_tree = new TTree("tray", "Per-tray notes and IV parameter sets");
+  tray_tree->Branch("tray", &tray);
+  tray_tree->Branch("mode", &mode, "mode/I");
+  tray_tree->Branch("tray_note", &tray_note);
+  tray_tree->Branch("test_time", &test_time, "test_time/L");
+  tray_tree->Branch("n_settings", &n_settings, "n_settings/I");
+  tray_tree->Branch("settings", settings, "settings[n_settings]/F");  // IV parameter set after the timestamp
+
+  for (int i_tray = 0; i_tray < n_trays; ++i_tray) {
+    IV_data*  IV  = i_tray < IV_trays->size()  ? IV_trays->at(i_tray)  : NULL;
+    SPS_data* SPS = i_tray < SPS_trays->size() ? SPS_trays->at(i_tray) : NULL;
+    tray = tray_strings->at(i_tray);
+    mode = tray_modes->at(i_tray);
+    tray_note = IV ? IV->tray_note : (SPS ? SPS->tray_note : "");
+    test_time = IV ? IV->parameters.timestamp : -999;
+    n_settings = IV ? IV->parameters.n_settings : 0;
+    for (int i = 0; i < n_settings; ++i) settings[i] = IV->parameters.settings[i];
+    tray_tree->Fill();
+  }// End of tray loop
+
+  outfile->Write();
+  std::cout << "Wrote " << t_mgn << sipm_tree->GetEntries() << t_def << " SiPMs from " << t_mgn << n_trays << t_def << " trays to " << t_blu << filename << t_def << std::endl;
+  outfile->Close();
+  delete outfile;
+  return true;
+}// End of SiPMTreeExport::writeSiPMTree
+
+#endif /* SiPMTreeExport_h */
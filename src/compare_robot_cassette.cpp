@@ -102,16 +102,8 @@ void makeCorrelationIV(std::string tray, bool flag_run_at_25_celcius) {
   float avg_diff = 0;
   
   // Find the data for the two requested trays from the reader
-  int index_1 = -1;
-  int index_2 = -1;
-  for (int i_tray = 0; i_tray < gReader->GetTrayStrings()->size(); ++i_tray) {
-    if (tray.compare(gReader->GetTrayStrings()->at(i_tray)) == 0) {
-      // Cassette data
-      if (gReader->GetTrayModes()->at(i_tray) == 0) index_1 = i_tray;
-      // Robot data
-      else if (gReader->GetTrayModes()->at(i_tray) == 1) index_2 = i_tray;
-    }
-  }// End of tray loop
+  int index_1 = gReader->FindTray(tray, 0); // Cassette data
+  int index_2 = gReader->FindTray(tray, 1); // Robot data
   bool failed_to_find_tray = false;
   if (index_1 == -1) {
     std::cerr << "Error in <sipm_batch_summary_sheet::makeCorrelationIV>: input tray cassette data not found." << std::endl;
@@ -124,12 +116,12 @@ void makeCorrelationIV(std::string tray, bool flag_run_at_25_celcius) {
   // Gather the input data to arrays that can be plotted
   int count_failures_1 = 0;
   std::vector<float> IV_valid_1;
-  std::vector<float>* IV_data_1;
+  TrayColumn<float> IV_data_1;
   if (!flag_run_at_25_celcius) IV_data_1 = gReader->GetIV()->at(index_1)->IV_Vpeak;
   else                         IV_data_1 = gReader->GetIV()->at(index_1)->IV_Vpeak_25C;
   int count_failures_2 = 0;
   std::vector<float> IV_valid_2;
-  std::vector<float>* IV_data_2;
+  TrayColumn<float> IV_data_2;
   if (!flag_run_at_25_celcius) IV_data_2 = gReader->GetIV()->at(index_2)->IV_Vpeak;
   else                         IV_data_2 = gReader->GetIV()->at(index_2)->IV_Vpeak_25C;
   
@@ -289,16 +281,8 @@ void makeCorrelationSPS(std::string tray, bool flag_run_at_25_celcius) {
   float avg_diff = 0;
   
   // Find the data for the two requested trays from the reader
-  int index_1 = -1;
-  int index_2 = -1;
-  for (int i_tray = 0; i_tray < gReader->GetTrayStrings()->size(); ++i_tray) {
-    if (tray.compare(gReader->GetTrayStrings()->at(i_tray)) == 0) {
-      // Cassette data
-      if (gReader->GetTrayModes()->at(i_tray) == 0) index_1 = i_tray;
-      // Robot data
-      else if (gReader->GetTrayModes()->at(i_tray) == 1) index_2 = i_tray;
-    }
-  }// End of tray loop
+  int index_1 = gReader->FindTray(tray, 0); // Cassette data
+  int index_2 = gReader->FindTray(tray, 1); // Robot data
   bool failed_to_find_tray = false;
   if (index_1 == -1) {
     std::cerr << "Error in <sipm_batch_summary_sheet::makeCorrelationSPS>: input tray cassette data not found." << std::endl;
@@ -311,12 +295,12 @@ void makeCorrelationSPS(std::string tray, bool flag_run_at_25_celcius) {
   // Gather the input data to arrays that can be plotted
   int count_failures_1 = 0;
   std::vector<float> SPS_valid_1;
-  std::vector<float>* SPS_data_1;
+  TrayColumn<float> SPS_data_1;
   if (!flag_run_at_25_celcius) SPS_data_1 = gReader->GetSPS()->at(index_1)->SPS_Vbd;
   else                         SPS_data_1 = gReader->GetSPS()->at(index_1)->SPS_Vbd_25C;
   int count_failures_2 = 0;
   std::vector<float> SPS_valid_2;
-  std::vector<float>* SPS_data_2;
+  TrayColumn<float> SPS_data_2;
   if (!flag_run_at_25_celcius) SPS_data_2 = gReader->GetSPS()->at(index_2)->SPS_Vbd;
   else                         SPS_data_2 = gReader->GetSPS()->at(index_2)->SPS_Vbd_25C;
   
@@ -477,16 +461,8 @@ void makeCorrelationDarkCurrent(std::string tray, bool below_breakdown) {
   float avg_diff = 0;
   
   // Find the data for the two requested trays from the reader
-  int index_1 = -1;
-  int index_2 = -1;
-  for (int i_tray = 0; i_tray < gReader->GetTrayStrings()->size(); ++i_tray) {
-    if (tray.compare(gReader->GetTrayStrings()->at(i_tray)) == 0) {
-      // Cassette data
-      if (gReader->GetTrayModes()->at(i_tray) == 0) index_1 = i_tray;
-      // Robot data
-      else if (gReader->GetTrayModes()->at(i_tray) == 1) index_2 = i_tray;
-    }
-  }// End of tray loop
+  int index_1 = gReader->FindTray(tray, 0); // Cassette data
+  int index_2 = gReader->FindTray(tray, 1); // Robot data
   bool failed_to_find_tray = false;
   if (index_1 == -1) {
     std::cerr << "Error in <sipm_batch_summary_sheet::makeCorrelationDarkCurrent>: input tray cassette data not found." << std::endl;
@@ -499,12 +475,12 @@ void makeCorrelationDarkCurrent(std::string tray, bool below_breakdown) {
   // Gather the input data to arrays that can be plotted
   int count_failures_1 = 0;
   std::vector<float> IDark_valid_1;
-  std::vector<float>* IDark_data_1;
+  TrayColumn<float> IDark_data_1;
   if (below_breakdown) IDark_data_1 = gReader->GetIV()->at(index_1)->Idark_3below;
   else                 IDark_data_1 = gReader->GetIV()->at(index_1)->Idark_4above;
   int count_failures_2 = 0;
   std::vector<float> IDark_valid_2;
-  std::vector<float>* IDark_data_2;
+  TrayColumn<float> IDark_data_2;
   if (below_breakdown) IDark_data_2 = gReader->GetIV()->at(index_2)->Idark_3below;
   else                 IDark_data_2 = gReader->GetIV()->at(index_2)->Idark_4above;
   
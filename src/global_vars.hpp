@@ -48,6 +48,12 @@ const char batch_data_file[20] = "../batch_data.txt";
 // flags to control some options in analysis
 bool flag_use_all_trays_for_averages = false;       // Use all available trays' data to compute averages (Recommended ONLY when all trays are similar)
 
+// Center of the outlier window (+/- declare_Vbd_outlier_range); the median and trimmed mean
+// are not pulled by a few failed fits
+enum OutlierCenter {kCenterMean, kCenterMedian, kCenterTrimmedMean};
+OutlierCenter outlier_center = kCenterMean;
+double outlier_trim_fraction = 0.1;                 // Fraction dropped at each end for kCenterTrimmedMean
+
 // Variables to control histogram/plot ranges
 const int nbin_temp_grad = 19;
 //const int nbin_temp_grad = 39;
@@ -12,6 +12,8 @@
 
 #include "global_vars.hpp"
 #include "SiPMDataReader.hpp"
+#include "SiPMStatsCache.hpp"
+#include "SiPMTrayStats.hpp"
 
 #ifndef sipm_analysis_helper_h
 #define sipm_analysis_helper_h
@@ -20,6 +22,7 @@
 
 // Small/general utils
 bool                          checkReader();
+std::vector<int>              getBatchTrays(const std::string& batch_label);
 float                         getAvgFromVector(std::vector<float>& vec);
 float                         getAvgFromVectorPointer(std::vector<float>* vec);
 
@@ -52,6 +55,30 @@ double                        getAvgVbreakdownAllTrays(bool flag_run_at_25_celci
 
 // Small Analysis Subroutines: RMS/STDev/Error
 
+// Generic statistics of any float column of IV_data/SPS_data (see Field statistics below)
+double                        getOutlierRange(float extra_tolerance = 0);
+template <auto Field> int     countValid(int tray_index);
+template <auto Field> int     countValidAllTrays();
+template <auto Field> int     countOutliers(int tray_index, float extra_tolerance = 0);
+template <auto Field> int     countOverLimitAllTrays(float limit);
+template <auto Field> double  getAvg(int tray_index);
+template <auto Field> double  getAvgAllTrays();
+template <auto Field> double  getStdev(int tray_index);
+template <auto Field> int     countValidBatch(const std::string& batch_label);
+template <auto Field> double  getAvgBatch(const std::string& batch_label);
+template <auto Field> double  getStdevBatch(const std::string& batch_label);
+
+// Robust statistics of any float column (see Robust statistics below)
+template <auto Field> double  getMedian(int tray_index);
+template <auto Field> double  getMedianAllTrays();
+template <auto Field> double  getMAD(int tray_index);
+template <auto Field> double  getMADAllTrays();
+template <auto Field> double  getQuantile(int tray_index, double q);
+template <auto Field> double  getQuantileAllTrays(double q);
+template <auto Field> double  getTrimmedMean(int tray_index, double trim_fraction = outlier_trim_fraction);
+template <auto Field> double  getTrimmedMeanAllTrays(double trim_fraction = outlier_trim_fraction);
+template <auto Field> double  getOutlierCenter(int tray_index);
+
 //========================================================================== General
 
 bool checkReader() {
@@ -61,6 +88,21 @@ bool checkReader() {
   }return true;
 }
 
+// Tray indices of a batch: from the reader's batch index if the label is a batch
+// (the tray ID before the '-', i.e. "250821" for "250821-1301"), otherwise every
+// tray with the substring "[batch label]" in its tray string.
+std::vector<int> getBatchTrays(const std::string& batch_label) {
+  if (!checkReader()) return std::vector<int>();
+  int batch = gReader->FindBatch(batch_label);
+  if (batch >= 0) return gReader->GetBatch(batch).trays;
+  
+  std::vector<int> trays;
+  std::vector<std::string>* tray_strings = gReader->GetTrayStrings();
+  for (int i = 0; i < tray_strings->size(); ++i) {
+    if (tray_strings->at(i).find(batch_label) != std::string::npos) trays.push_back(i);
+  }return trays;
+}// End of sipm_analysis_helper::getBatchTrays
+
 // Establish the directory structure (TODO)
 //bool statDirectories(const char* batch_string) {
 //  
@@ -82,6 +124,189 @@ float getAvgFromVectorPointer(std::vector<float>* vec) {
 }
 
 
+//========================================================================== Field statistics
+
+// A field is a column member chosen at compile time, e.g.
+//   getAvg<&IV_data::Idark_4above>(tray_index)
+//   countOutliers<&SPS_data::SPS_chi2ndf>(tray_index, 0.01)
+// Every float quantity gets the same cached, one-pass statistics (gTrayStatsCache)
+// and the masked kernels; the V_peak/V_breakdown methods below are these fields
+// with the temperature correction picked once per call.
+
+// Half width of the outlier window around the average
+// Use quadrature sum if desired
+double getOutlierRange(float extra_tolerance) {
+  if (use_quadrature_sum_for_syst_error)
+    return std::sqrt(declare_Vbd_outlier_range * declare_Vbd_outlier_range
+                     + std::fabs(extra_tolerance)*extra_tolerance);
+  return declare_Vbd_outlier_range + extra_tolerance;
+}// End of sipm_analysis_helper::getOutlierRange
+
+// Is tray_index a tray of the field's data type?
+template <auto Field>
+bool checkFieldIndex(int tray_index, const char* method) {
+  if (!checkReader()) return false;
+  if (tray_index >= 0 && tray_index < TrayField<Field>::Trays(gReader)->size()) return true;
+  std::cerr << "Error in <sipm_analysis_helper::" << method << ">: Invalid index." << std::endl;
+  return false;
+}
+
+// Valid measurements of the field in a tray (failed measurements and missing SiPMs are not in the mask)
+template <auto Field>
+int countValid(int tray_index) {
+  if (!checkFieldIndex<Field>(tray_index, "countValid")) return 0;
+  return gTrayStatsCache.Get<Field>(gReader, tray_index).n;
+}
+
+template <auto Field>
+int countValidAllTrays() {
+  if (!checkReader()) return 0;
+  return gTrayStatsCache.GetAll<Field>(gReader).n;
+}
+
+// Valid measurements at or beyond getOutlierRange(extra_tolerance) from the tray center,
+// or from the all-tray center with flag_use_all_trays_for_averages (see getOutlierCenter)
+template <auto Field>
+int countOutliers(int tray_index, float extra_tolerance) {
+  if (!checkFieldIndex<Field>(tray_index, "countOutliers")) return 0;
+  const TrayColumn<float>* column = TrayField<Field>::Column(gReader, tray_index);
+  if (!column) return 0;
+  return maskedCountOutside(*column, getOutlierCenter<Field>(tray_index), getOutlierRange(extra_tolerance));
+}// End of sipm_analysis_helper::countOutliers
+
+// Valid measurements strictly above limit, over all trays
+template <auto Field>
+int countOverLimitAllTrays(float limit) {
+  if (!checkReader()) return 0;
+  int count_above = 0;
+  for (int i = 0; i < TrayField<Field>::Trays(gReader)->size(); ++i) {
+    const TrayColumn<float>* column = TrayField<Field>::Column(gReader, i);
+    if (column) count_above += maskedCountAbove(*column, limit);
+  }return count_above;
+}// End of sipm_analysis_helper::countOverLimitAllTrays
+
+// Average of the valid measurements in a tray (-1 for an invalid index)
+template <auto Field>
+double getAvg(int tray_index) {
+  if (!checkFieldIndex<Field>(tray_index, "getAvg")) return -1;
+  return gTrayStatsCache.Get<Field>(gReader, tray_index).avg;
+}
+
+template <auto Field>
+double getAvgAllTrays() {
+  if (!checkReader()) return -1;
+  return gTrayStatsCache.GetAll<Field>(gReader).avg;
+}
+
+// Population standard deviation of the valid measurements in a tray (-1 for an invalid index)
+template <auto Field>
+double getStdev(int tray_index) {
+  if (!checkFieldIndex<Field>(tray_index, "getStdev")) return -1;
+  return gTrayStatsCache.Get<Field>(gReader, tray_index).stdev;
+}
+
+// Batch statistics, merged from the tray entries (see getBatchTrays for the label)
+// Batch labels are cached per batch; other labels merge the matching trays on each call.
+template <auto Field>
+TrayMoments getBatchMoments(const std::string& batch_label) {
+  int batch = gReader->FindBatch(batch_label);
+  if (batch >= 0) return gTrayStatsCache.GetBatch<Field>(gReader, batch);
+  return gTrayStatsCache.GetTrays<Field>(gReader, getBatchTrays(batch_label));
+}
+
+template <auto Field>
+int countValidBatch(const std::string& batch_label) {
+  if (!checkReader()) return 0;
+  return getBatchMoments<Field>(batch_label).n;
+}
+
+template <auto Field>
+double getAvgBatch(const std::string& batch_label) {
+  if (!checkReader()) return -1;
+  return getBatchMoments<Field>(batch_label).avg;
+}
+
+template <auto Field>
+double getStdevBatch(const std::string& batch_label) {
+  if (!checkReader()) return -1;
+  return getBatchMoments<Field>(batch_label).stdev;
+}
+
+//========================================================================== Robust statistics
+
+// Order statistics of the valid measurements, found by selection on a copy (no full sort).
+// A few failed fits move the average; they barely move the median or the trimmed mean.
+// Invalid indices give -1, trays without valid measurements NaN.
+
+template <auto Field>
+double getMedian(int tray_index) {
+  if (!checkFieldIndex<Field>(tray_index, "getMedian")) return -1;
+  return gTrayStatsCache.GetRobust<Field>(gReader, tray_index).median;
+}
+
+template <auto Field>
+double getMedianAllTrays() {
+  if (!checkReader()) return -1;
+  return gTrayStatsCache.GetRobustAll<Field>(gReader).median;
+}
+
+// Median absolute deviation from the median (times 1.4826 for a standard deviation estimate)
+template <auto Field>
+double getMAD(int tray_index) {
+  if (!checkFieldIndex<Field>(tray_index, "getMAD")) return -1;
+  return gTrayStatsCache.GetRobust<Field>(gReader, tray_index).mad;
+}
+
+template <auto Field>
+double getMADAllTrays() {
+  if (!checkReader()) return -1;
+  return gTrayStatsCache.GetRobustAll<Field>(gReader).mad;
+}
+
+// q-quantile, 0 <= q <= 1 (linear interpolation between order statistics)
+template <auto Field>
+double getQuantile(int tray_index, double q) {
+  if (!checkFieldIndex<Field>(tray_index, "getQuantile")) return -1;
+  const TrayColumn<float>* column = TrayField<Field>::Column(gReader, tray_index);
+  return column ? maskedQuantile(*column, q) : NAN;
+}
+
+template <auto Field>
+double getQuantileAllTrays(double q) {
+  if (!checkReader()) return -1;
+  std::vector<float>& values = gTrayStatsCache.GatherAll<Field>(gReader);
+  return selectQuantile(values.data(), values.size(), q);
+}
+
+// Average after dropping the lowest and highest trim_fraction of the measurements
+template <auto Field>
+double getTrimmedMean(int tray_index, double trim_fraction) {
+  if (!checkFieldIndex<Field>(tray_index, "getTrimmedMean")) return -1;
+  return gTrayStatsCache.GetTrimmedMean<Field>(gReader, tray_index, trim_fraction);
+}
+
+template <auto Field>
+double getTrimmedMeanAllTrays(double trim_fraction) {
+  if (!checkReader()) return -1;
+  return gTrayStatsCache.GetTrimmedMeanAll<Field>(gReader, trim_fraction);
+}
+
+// Center of the outlier window in countOutliers: the average, median or trimmed mean
+// (outlier_center) of the tray, or of all trays with flag_use_all_trays_for_averages
+template <auto Field>
+double getOutlierCenter(int tray_index) {
+  switch (outlier_center) {
+    case kCenterMedian:
+      return flag_use_all_trays_for_averages ? getMedianAllTrays<Field>() : getMedian<Field>(tray_index);
+    case kCenterTrimmedMean:
+      return flag_use_all_trays_for_averages ? getTrimmedMeanAllTrays<Field>(outlier_trim_fraction)
+                                             : getTrimmedMean<Field>(tray_index, outlier_trim_fraction);
+    default:
+      return flag_use_all_trays_for_averages ? gTrayStatsCache.GetAll<Field>(gReader).avg
+                                             : gTrayStatsCache.Get<Field>(gReader, tray_index).avg;
+  }
+}// End of sipm_analysis_helper::getOutlierCenter
+
 //========================================================================== Counting/Tallying
 
 
@@ -90,15 +315,7 @@ float getAvgFromVectorPointer(std::vector<float>* vec) {
 // Important since the data could vary if some trays are incomplete
 int countSiPMsAllTrays() {
   if (!checkReader()) return 0;
-  int count_SiPM = 0;
-  for (std::vector<IV_data*>::iterator tray_to_analyze = gReader->GetIV()->begin();
-       tray_to_analyze != gReader->GetIV()->end(); ++tray_to_analyze) {
-    for (std::vector<float>::iterator it = (*tray_to_analyze)->IV_Vpeak->begin();
-         it != (*tray_to_analyze)->IV_Vpeak->end(); ++it) {
-      if (*it == -999) continue; // -999: failed measurement or missing SiPM
-      ++count_SiPM;
-    }
-  }return count_SiPM;
+  return countValidAllTrays<&IV_data::IV_Vpeak>(); // Failed measurements and missing SiPMs are not in the mask
 }// End of sipm_analysis_helper::countSiPMsAllTrays
 
 // Count the number of SiPMs available in a given tray
@@ -107,31 +324,16 @@ int countValidSiPMs(int tray_index) {
   if (!checkReader()) return 0;
   if (tray_index < 0 || tray_index >= gReader->GetTrayStrings()->size()) return 0;
   
-  int count_SiPM = 0;
-  for (std::vector<float>::iterator it = gReader->GetIV()->at(tray_index)->IV_Vpeak->begin();
-       it != gReader->GetIV()->at(tray_index)->IV_Vpeak->end(); ++it) {
-    if (*it == -999) continue; // -999: failed measurement or missing SiPM
-    ++count_SiPM;
-  }return count_SiPM;
+  // Failed measurements and missing SiPMs are not in the mask
+  return countValid<&IV_data::IV_Vpeak>(tray_index);
 }// End of sipm_analysis_helper::countValidSiPMs
 
 // Count the number of valid SiPMsin a given batch of SiPMs
-// This considers trays with a substring "[batch label]" in the
-// tray string, i.e. "250821-1301" in batch "250821".
+// A batch label is the tray ID before the '-', i.e. "250821-1301" in batch "250821";
+// other labels select the trays with a substring "[batch label]" (see getBatchTrays).
 int countValidSiPMsBatch(std::string batch_label) {
-  std::vector<std::string>* batch_strings = gReader->GetTrayStrings();
-  
-  int total_valid_sipm = 0;
-  int count = -1;
-  for (std::vector<std::string>::iterator it = batch_strings->begin(); it != batch_strings->end(); ++it) {
-    ++count;
-    
-    if (it->find(batch_label) == std::string::npos) continue;
-    
-    total_valid_sipm += countValidSiPMs(count);
-  }// End of string loop
-  return total_valid_sipm;
-}// End of sipm_analysis_helper::countValidSiPMs
+  return countValidBatch<&IV_data::IV_Vpeak>(batch_label);
+}// End of sipm_analysis_helper::countValidSiPMsBatch
 
 
 // Compute the average V_peak (IV curve) for a single tray in gReader
@@ -157,35 +359,11 @@ int countOutliersVpeak(int tray_index, bool flag_run_at_25_celcius, float extra_
   }
   
   // Compare against the average +/- 50mv
-  double V_avg;
-  if (flag_use_all_trays_for_averages) 
-    V_avg = getAvgVpeakAllTrays(flag_run_at_25_celcius);
-  else
-    V_avg = getAvgVpeak(tray_index, flag_run_at_25_celcius);
-  
-  // Use quadrature sum if desired
-  double V_outlier;
-  if (use_quadrature_sum_for_syst_error)
-    V_outlier = std::sqrt(declare_Vbd_outlier_range * declare_Vbd_outlier_range 
-                          + std::fabs(extra_tolerance)*extra_tolerance);
-  else
-    V_outlier = declare_Vbd_outlier_range + extra_tolerance;
-  
-  // Begin tallying outliers against the chosen average
-  IV_data* tray_to_analyze = gReader->GetIV()->at(tray_index);
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak_25C->begin();
-         it != tray_to_analyze->IV_Vpeak_25C->end(); ++it) {
-      
-      if (std::fabs(*it - V_avg) >= V_outlier) ++count_outliers;
-    }// End of loop over 25C-corrected IV data
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak->begin();
-         it != tray_to_analyze->IV_Vpeak->end(); ++it) {
-      
-      if (std::fabs(*it - V_avg) >= V_outlier) ++count_outliers;
-    }// End of loop over raw IV data
-  }return count_outliers;
+  // Only valid measurements are considered--missing SiPMs are not outliers
+  if (flag_run_at_25_celcius) // Extrapolated to 25 degrees Celcius
+    return countOutliers<&IV_data::IV_Vpeak_25C>(tray_index, extra_tolerance);
+  else                        // At recoreded temperature
+    return countOutliers<&IV_data::IV_Vpeak>(tray_index, extra_tolerance);
 }// End of sipm_analysis_helper::countOutliersVpeak
 
 
@@ -212,71 +390,33 @@ int countOutliersVbreakdown(int tray_index, bool flag_run_at_25_celcius, float e
   }
   
   // Compare against the average +/- 50mv
-  double V_avg;
-  if (flag_use_all_trays_for_averages)
-    V_avg = getAvgVbreakdownAllTrays(flag_run_at_25_celcius);
-  else
-    V_avg = getAvgVbreakdown(tray_index, flag_run_at_25_celcius);
-  
-  // Use quadrature sum if desired
-  double V_outlier;
-  if (use_quadrature_sum_for_syst_error)
-    V_outlier = std::sqrt(declare_Vbd_outlier_range * declare_Vbd_outlier_range
-                          + std::fabs(extra_tolerance)*extra_tolerance);
-  else
-    V_outlier = declare_Vbd_outlier_range + extra_tolerance;
-  
-  // Begin tallying outliers against the chosen average
-  SPS_data* tray_to_analyze = gReader->GetSPS()->at(tray_index);
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd_25C->begin();
-         it != tray_to_analyze->SPS_Vbd_25C->end(); ++it) {
-      
-      if (std::fabs(*it - V_avg) >= V_outlier) ++count_outliers;
-    }// End of loop over 25C-corrected SPS data
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd->begin();
-         it != tray_to_analyze->SPS_Vbd->end(); ++it) {
-      
-      if (std::fabs(*it - V_avg) >= V_outlier) ++count_outliers;
-    }// End of loop over raw SPS data
-  }return count_outliers;
+  // Only valid measurements are considered--missing SiPMs are not outliers
+  if (flag_run_at_25_celcius) // Extrapolated to 25 degrees Celcius
+    return countOutliers<&SPS_data::SPS_Vbd_25C>(tray_index, extra_tolerance);
+  else                        // At recoreded temperature
+    return countOutliers<&SPS_data::SPS_Vbd>(tray_index, extra_tolerance);
 }// End of sipm_analysis_helper::countOutliersVbreakdown
 
 
 // Count the number of IV outliers for a set of trays in a batch
-// This considers trays with a substring "[batch label]" in the
-// tray string, i.e. "250821-1301" in batch "250821".
+// A batch label is the tray ID before the '-', i.e. "250821-1301" in batch "250821";
+// other labels select the trays with a substring "[batch label]" (see getBatchTrays).
 int countOutliersVpeakBatch(std::string batch_label, bool flag_run_at_25_celcius, float extra_tolerance) {
-  std::vector<std::string>* batch_strings = gReader->GetTrayStrings();
+  std::vector<int> trays = getBatchTrays(batch_label);
   
   int total_outliers = 0;
-  int count = -1;
-  for (std::vector<std::string>::iterator it = batch_strings->begin(); it != batch_strings->end(); ++it) {
-    ++count;
-    
-    if (it->find(batch_label) == std::string::npos) continue;
-    
-    total_outliers += countOutliersVpeak(count, flag_run_at_25_celcius, extra_tolerance);
-  }// End of string loop
+  for (int i = 0; i < trays.size(); ++i) total_outliers += countOutliersVpeak(trays[i], flag_run_at_25_celcius, extra_tolerance);
   return total_outliers;
 }// End of sipm_analysis_helper::countOutliersVpeakBatch
 
 // Count the number of SPS outliers for a set of trays in a batch
-// This considers trays with a substring "[batch label]" in the
-// tray string, i.e. "250821-1301" in batch "250821".
+// A batch label is the tray ID before the '-', i.e. "250821-1301" in batch "250821";
+// other labels select the trays with a substring "[batch label]" (see getBatchTrays).
 int countOutliersVbreakdownBatch(std::string batch_label, bool flag_run_at_25_celcius, float extra_tolerance) {
-  std::vector<std::string>* batch_strings = gReader->GetTrayStrings();
+  std::vector<int> trays = getBatchTrays(batch_label);
   
   int total_outliers = 0;
-  int count = -1;
-  for (std::vector<std::string>::iterator it = batch_strings->begin(); it != batch_strings->end(); ++it) {
-    ++count;
-    
-    if (it->find(batch_label) == std::string::npos) continue;
-    
-    total_outliers += countOutliersVbreakdown(count, flag_run_at_25_celcius, extra_tolerance);
-  }// End of string loop
+  for (int i = 0; i < trays.size(); ++i) total_outliers += countOutliersVbreakdown(trays[i], flag_run_at_25_celcius, extra_tolerance);
   return total_outliers;
 }// End of sipm_analysis_helper::countOutliersVbreakdownBatch
 
@@ -285,14 +425,7 @@ int countOutliersVbreakdownBatch(std::string batch_label, bool flag_run_at_25_ce
 // Tally the number of SiPMs with dark current at 4 overvolt above some limit
 // Useful for comparing against spec sheet limits
 int countDarkCurrentOverLimitAllTrays(float limit) {
-  int count_above = 0;
-  for (std::vector<IV_data*>::iterator tray_to_analyze = gReader->GetIV()->begin();
-       tray_to_analyze != gReader->GetIV()->end(); ++tray_to_analyze) {
-    for (std::vector<float>::iterator it = (*tray_to_analyze)->Idark_4above->begin();
-         it != (*tray_to_analyze)->Idark_4above->end(); ++it) {
-      if (*it > limit) ++count_above;
-    }
-  }return count_above;
+  return countOverLimitAllTrays<&IV_data::Idark_4above>(limit);
 }// End of sipm_analysis_helper::countDarkCurrentOverLimitAllTrays
 
 //========================================================================== Averaging
@@ -308,24 +441,8 @@ double getAvgVpeak(int tray_index, bool flag_run_at_25_celcius) {
     return -1;
   }
   
-  IV_data* tray_to_analyze = gReader->GetIV()->at(tray_index);
-  double avg_Vpeak = 0;
-  int count_failed_measurements = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak_25C->begin();
-         it != tray_to_analyze->IV_Vpeak_25C->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      avg_Vpeak += *it;
-    }
-    avg_Vpeak /= static_cast<double>(tray_to_analyze->IV_Vpeak_25C->size() - count_failed_measurements);
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak->begin();
-         it != tray_to_analyze->IV_Vpeak->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      avg_Vpeak += *it;
-    }
-    avg_Vpeak /= static_cast<double>(tray_to_analyze->IV_Vpeak->size() - count_failed_measurements);
-  }return avg_Vpeak;
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  return flag_run_at_25_celcius ? getAvg<&IV_data::IV_Vpeak_25C>(tray_index) : getAvg<&IV_data::IV_Vpeak>(tray_index);
 }// End of sipm_analysis_helper::getAvgVpeak
 
 
@@ -334,26 +451,8 @@ double getAvgVpeak(int tray_index, bool flag_run_at_25_celcius) {
 // The computation can be done at the recorded temperatures (which vary)
 // or under the extrapolation to 25 degrees Celcius.
 double getAvgVpeakAllTrays(bool flag_run_at_25_celcius) {
-  double avg_Vpeak = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<IV_data*>::iterator tray_to_analyze = gReader->GetIV()->begin();
-         tray_to_analyze != gReader->GetIV()->end(); ++tray_to_analyze) {
-      for (std::vector<float>::iterator it = (*tray_to_analyze)->IV_Vpeak_25C->begin();
-           it != (*tray_to_analyze)->IV_Vpeak_25C->end(); ++it) {
-        if (*it == -999 || std::isnan(*it)) continue;
-        avg_Vpeak += *it;
-      }
-    }
-  } else {// At recoreded temperature
-    for (std::vector<IV_data*>::iterator tray_to_analyze = gReader->GetIV()->begin();
-         tray_to_analyze != gReader->GetIV()->end(); ++tray_to_analyze) {
-      for (std::vector<float>::iterator it = (*tray_to_analyze)->IV_Vpeak->begin();
-           it != (*tray_to_analyze)->IV_Vpeak->end(); ++it) {
-        if (*it == -999 || std::isnan(*it)) continue;
-        avg_Vpeak += *it;
-      }
-    }
-  }return avg_Vpeak / countSiPMsAllTrays();
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  return flag_run_at_25_celcius ? getAvgAllTrays<&IV_data::IV_Vpeak_25C>() : getAvgAllTrays<&IV_data::IV_Vpeak>();
 }// End of sipm_analysis_helper::getAvgVpeakAllTrays
 
 
@@ -367,24 +466,8 @@ double getAvgVbreakdown(int tray_index, bool flag_run_at_25_celcius) {
     return -1;
   }
   
-  SPS_data* tray_to_analyze = gReader->GetSPS()->at(tray_index);
-  double avg_Vbreakdown = 0;
-  int count_failed_measurements = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd_25C->begin();
-         it != tray_to_analyze->SPS_Vbd_25C->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      avg_Vbreakdown += *it;
-    }
-    avg_Vbreakdown /= static_cast<double>(tray_to_analyze->SPS_Vbd_25C->size() - count_failed_measurements);
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd->begin();
-         it != tray_to_analyze->SPS_Vbd->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      avg_Vbreakdown += *it;
-    }
-    avg_Vbreakdown /= static_cast<double>(tray_to_analyze->SPS_Vbd->size() - count_failed_measurements);
-  }return avg_Vbreakdown;
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  return flag_run_at_25_celcius ? getAvg<&SPS_data::SPS_Vbd_25C>(tray_index) : getAvg<&SPS_data::SPS_Vbd>(tray_index);
 }// End of sipm_analysis_helper::getAvgVbreakdown
 
 
@@ -393,26 +476,9 @@ double getAvgVbreakdown(int tray_index, bool flag_run_at_25_celcius) {
 // The computation can be done at the recorded temperatures (which vary)
 // or under the extrapolation to 25 degrees Celcius.
 double getAvgVbreakdownAllTrays(bool flag_run_at_25_celcius) {
-  double avg_Vbreakdown = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<SPS_data*>::iterator tray_to_analyze = gReader->GetSPS()->begin();
-         tray_to_analyze != gReader->GetSPS()->end(); ++tray_to_analyze) {
-      for (std::vector<float>::iterator it = (*tray_to_analyze)->SPS_Vbd_25C->begin();
-           it != (*tray_to_analyze)->SPS_Vbd_25C->end(); ++it) {
-        if (*it == -999 || std::isnan(*it)) continue;
-        avg_Vbreakdown += *it;
-      }
-    }
-  } else {// At recoreded temperature
-    for (std::vector<SPS_data*>::iterator tray_to_analyze = gReader->GetSPS()->begin();
-         tray_to_analyze != gReader->GetSPS()->end(); ++tray_to_analyze) {
-      for (std::vector<float>::iterator it = (*tray_to_analyze)->SPS_Vbd->begin();
-           it != (*tray_to_analyze)->SPS_Vbd->end(); ++it) {
-        if (*it == -999 || std::isnan(*it)) continue;
-        avg_Vbreakdown += *it;
-      }
-    }
-  }return avg_Vbreakdown / countSiPMsAllTrays();
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  // Counts valid SPS results, which need not match the IV ones
+  return flag_run_at_25_celcius ? getAvgAllTrays<&SPS_data::SPS_Vbd_25C>() : getAvgAllTrays<&SPS_data::SPS_Vbd>();
 }// End of sipm_analysis_helper::getAvgVbreakdownAllTrays
 
 //========================================================================== RMS/STDev/Error
@@ -426,25 +492,8 @@ double getStdevVpeak(int tray_index, bool flag_run_at_25_celcius) {
     return -1;
   }
   
-  IV_data* tray_to_analyze = gReader->GetIV()->at(tray_index);
-  double avg_Vpeak = getAvgVpeak(tray_index, flag_run_at_25_celcius);
-  double stdev_Vpeak = 0;
-  int count_failed_measurements = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak_25C->begin();
-         it != tray_to_analyze->IV_Vpeak_25C->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      stdev_Vpeak += (*it - avg_Vpeak)*(*it - avg_Vpeak);
-    }
-    stdev_Vpeak /= static_cast<double>(tray_to_analyze->IV_Vpeak_25C->size() - count_failed_measurements);
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->IV_Vpeak->begin();
-         it != tray_to_analyze->IV_Vpeak->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      stdev_Vpeak += (*it - avg_Vpeak)*(*it - avg_Vpeak);
-    }
-    stdev_Vpeak /= static_cast<double>(tray_to_analyze->IV_Vpeak->size() - count_failed_measurements);
-  }return std::sqrt(stdev_Vpeak);
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  return flag_run_at_25_celcius ? getStdev<&IV_data::IV_Vpeak_25C>(tray_index) : getStdev<&IV_data::IV_Vpeak>(tray_index);
 }// End of sipm_analysis_helper::getStdevVpeak
 
 
@@ -458,25 +507,8 @@ double getStdevVbreakdown(int tray_index, bool flag_run_at_25_celcius) {
     return -1;
   }
   
-  SPS_data* tray_to_analyze = gReader->GetSPS()->at(tray_index);
-  double avg_Vbreakdown = getAvgVbreakdown(tray_index, flag_run_at_25_celcius);
-  double stdev_Vbreakdown = 0;
-  int count_failed_measurements = 0;
-  if (flag_run_at_25_celcius) {// Extrapolated to 25 degrees Celcius
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd_25C->begin();
-         it != tray_to_analyze->SPS_Vbd_25C->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      stdev_Vbreakdown += (*it - avg_Vbreakdown)*(*it - avg_Vbreakdown);
-    }
-    stdev_Vbreakdown /= static_cast<double>(tray_to_analyze->SPS_Vbd_25C->size() - count_failed_measurements);
-  } else {// At recoreded temperature
-    for (std::vector<float>::iterator it = tray_to_analyze->SPS_Vbd->begin();
-         it != tray_to_analyze->SPS_Vbd->end(); ++it) {
-      if (*it == -999 || std::isnan(*it)) {++count_failed_measurements; continue;}
-      stdev_Vbreakdown += (*it - avg_Vbreakdown)*(*it - avg_Vbreakdown);
-    }
-    stdev_Vbreakdown /= static_cast<double>(tray_to_analyze->SPS_Vbd->size() - count_failed_measurements);
-  }return std::sqrt(stdev_Vbreakdown);
+  // Extrapolated to 25 degrees Celcius or at recoreded temperature
+  return flag_run_at_25_celcius ? getStdev<&SPS_data::SPS_Vbd_25C>(tray_index) : getStdev<&SPS_data::SPS_Vbd>(tray_index);
 }// End of sipm_analysis_helper::getStdevVbreakdown
 
 
@@ -317,51 +317,63 @@ void makeHist_DarkCurrent() {
     
     num_trays_displayed = gReader->GetTrayStrings()->size();
   } else if (tray_display_mode == 2) {
-    // Find the tray ranges to report in a slightly more condensed fasion
-    std::vector<std::string> tray_batches;
-    std::vector<int> tray_batch_min;
-    std::vector<int> tray_batch_max;
-    std::vector<int> tray_modes;
-    for (int i_tray = 0; i_tray < gReader->GetTrayStrings()->size(); ++i_tray) {
-      
-      // Check if this tray batch exists already
-      std::string read_batch = gReader->GetTrayStrings()->at(i_tray).substr(0, 9);
-      for (int i_cand = 0; i_cand < tray_batches.size(); ++i_cand) {
-        if (read_batch.compare(tray_batches.at(i_cand)) == 0) {
-          // Match found!
-          int c_index = std::stoi(gReader->GetTrayStrings()->at(i_tray).substr(9, 11));
-          if (c_index < tray_batch_min[i_cand]) tray_batch_min[i_cand] = c_index;
-          if (c_index > tray_batch_max[i_cand]) tray_batch_max[i_cand] = c_index;
-          
-          // continue
-          goto nextloop;
+    // Find the tray ranges to report in a slightly more condensed fasion:
+    // trays of a batch are grouped by their series (tray number / 100), e.g. 250821-13{01-05}
+    struct TraySeries {
+      std::string label;
+      int         min;
+      int         max;
+      int         mode;        // Mode of the first tray
+      int         first_tray;  // List order of the first tray
+    };
+    std::vector<TraySeries> tray_series;
+    for (int i_batch = 0; i_batch < gReader->GetNBatches(); ++i_batch) {
+      const TrayBatch& batch = gReader->GetBatch(i_batch);
+      int batch_first_series = tray_series.size();
+      for (int j = 0; j < batch.trays.size(); ++j) {
+        int number = batch.tray_numbers[j];
+        int i_tray = batch.trays[j];
+        
+        // Check if this series exists already (only the batch's own series can match)
+        int i_series = batch_first_series;
+        while (i_series < tray_series.size() && (number < 0 || tray_series[i_series].min < 0 || tray_series[i_series].min / 100 != number / 100)) ++i_series;
+        if (i_series < tray_series.size()) {
+          tray_series[i_series].min = std::min(tray_series[i_series].min, number);
+          tray_series[i_series].max = std::max(tray_series[i_series].max, number);
+          continue;
         }
-      }// End of check
-      
-      // Not found--Append to list
-      tray_batches.push_back(read_batch);
-      tray_batch_min.push_back(std::stoi(gReader->GetTrayStrings()->at(i_tray).substr(9, 11)));
-      tray_batch_max.push_back(std::stoi(gReader->GetTrayStrings()->at(i_tray).substr(9, 11)));
-      tray_modes.push_back(gReader->GetTrayModes()->at(i_tray));
-      
-    nextloop:
-      continue;
+        
+        // Not found--Append to list. Tray IDs without a number after the '-' are listed as they are
+        TraySeries series;
+        series.label = number < 0 ? gReader->GetTrayStrings()->at(i_tray) : Form("%s-%02d", batch.label.c_str(), number / 100);
+        series.min = number;
+        series.max = number;
+        series.mode = gReader->GetTrayModes()->at(i_tray);
+        series.first_tray = i_tray;
+        tray_series.push_back(series);
+      }
     }// End of tray data sorting/condensing
     
+    // Keep the order of the tray list
+    std::sort(tray_series.begin(), tray_series.end(),
+              [](const TraySeries& a, const TraySeries& b) {return a.first_tray < b.first_tray;});
+    
     // Add a note for which SiPM trays are included in the data
     
     drawText("Data SiPM Tray IDs:", hamamatsu_tray_xpos-0.02, hamamatsu_tray_ypos, false, kBlack, 0.034);
-    for (int i_list = 1; i_list <= tray_batches.size(); ++i_list) {
+    for (int i_list = 1; i_list <= tray_series.size(); ++i_list) {
+      const TraySeries& series = tray_series[i_list-1];
+      std::string series_text = series.min < 0 ? series.label : Form("%s{%02d-%02d}", series.label.c_str(), series.min % 100, series.max % 100);
       if (i_list % 2 == 0) {
-        drawText(Form("%s{%02d-%02d}", tray_batches[i_list-1].c_str(), tray_batch_min[i_list-1],tray_batch_max[i_list-1]),
-                 hamamatsu_tray_xpos + 0.14, hamamatsu_tray_ypos - text_size*std::floor((i_list+1)/2), false, plot_colors[tray_modes[i_list-1]], text_size);
+        drawText(series_text.c_str(),
+                 hamamatsu_tray_xpos + 0.14, hamamatsu_tray_ypos - text_size*std::floor((i_list+1)/2), false, plot_colors[series.mode], text_size);
       } else {
-        drawText(Form("%s{%02d-%02d}", tray_batches[i_list-1].c_str(), tray_batch_min[i_list-1],tray_batch_max[i_list-1]),
-                 hamamatsu_tray_xpos, hamamatsu_tray_ypos - text_size*std::floor((i_list+1)/2), false, plot_colors[tray_modes[i_list-1]], text_size);
+        drawText(series_text.c_str(),
+                 hamamatsu_tray_xpos, hamamatsu_tray_ypos - text_size*std::floor((i_list+1)/2), false, plot_colors[series.mode], text_size);
       }
     }// End of tray drawing
     
-    num_trays_displayed = tray_batches.size();
+    num_trays_displayed = tray_series.size();
   }// End of tray display
   
   // Mark note counts over spec maxiumum
@@ -10,6 +10,7 @@
 
 #include "global_vars.hpp"
 #include "SiPMDataReader.hpp"
+#include "SiPMDatasetRegistry.hpp"
 #include "sipm_analysis_helper.hpp"
 
 //========================================================================== Global Variables
@@ -63,6 +64,10 @@ double darkcurr_limits[2] = {0, 35};
 
 
 
+// Datasets used by the systematic studies, held together so a study can
+// reference another (e.g. production next to repsyst) without re-reading it
+SiPMDatasetRegistry gDatasets;
+
 // TODO make plotter class??? Or at least consider it...
 
 //========================================================================== Forward declarations
@@ -85,6 +90,9 @@ void makeOperatingVoltageScan();
 // Surface Imperfections
 void makeSurfaceImperfectionCorrelation();
 
+// Datasets
+void registerSystematicDatasets();
+
 //========================================================================== Macro Main
 
 // Main macro method: generate SiPM data
@@ -92,8 +100,9 @@ void systematic_analysis_summary() {
   
   // *-- Analysis setup
   
-  // Initialize SiPMDataReader
-  SiPMDataReader* reader = new SiPMDataReader();
+  // Read all datasets up front, in parallel
+  registerSystematicDatasets();
+  gDatasets.Load({"repsyst", "vopscan", "tempscan", "cyclescan", "production"});
   
   // Initialize canvases
   gStyle->SetOptStat(0);
@@ -105,11 +114,8 @@ void systematic_analysis_summary() {
   
   // *-- Analysis tasks: Reproducibility
   
-  // Read IV and SPS data for reproducibility tests
-  reader->SetSubDirectory("repsyst");
-  reader->ReadFile("../data/syst_traylist_repsyst.txt");
-  reader->ReadDataIV();
-  reader->ReadDataSPS();
+  // IV and SPS data for reproducibility tests
+  gDatasets.Use("repsyst");
   
   // Run for both temperature correction states
   for (int i_tempcorr = 0; i_tempcorr < 2; ++i_tempcorr) {
@@ -138,30 +144,18 @@ void systematic_analysis_summary() {
   
   // *-- Analysis tasks: Operating Voltage
   
-  // Read IV and SPS data for vop scan
-  reader->SetFlatTrayString(); // Don't require parent directories end in "-results"
-  reader->SetSubDirectory("vopscan");
-  reader->ReadFile("../data/syst_traylist_vopscan.txt");
-  reader->ReadDataIV();
-  reader->ReadDataSPS();
+  // IV and SPS data for vop scan
+  gDatasets.Use("vopscan");
   
   makeOperatingVoltageScan();
   
   // *-- Analysis tasks: Temperature
-  reader->SetFlatTrayString(); // Don't require parent directories end in "-results"
-  reader->SetSubDirectory("tempscan");
-  reader->ReadFile("../data/syst_traylist_tempscan.txt");
-  reader->ReadDataIV();
-  reader->ReadDataSPS();
+  gDatasets.Use("tempscan");
   
   makeTemperatureScan();
   
   // *-- Analysis tasks: Cycle scan
-  reader->SetFlatTrayString(); // Don't require parent directories end in "-results"
-  reader->SetSubDirectory("cyclescan");
-  reader->ReadFile("../data/syst_traylist_cyclescan.txt");
-  reader->ReadDataIV();
-  reader->ReadDataSPS();
+  gDatasets.Use("cyclescan");
   
   makeCycleScan();
   
@@ -174,11 +168,7 @@ void systematic_analysis_summary() {
   // *-- Analysis tasks: Surface Imperfection study
   // Do SiPMs with obstructed surfaces behave more poorly?
   global_flag_run_at_25_celcius = true;
-  reader->SetDefTrayString(); // return to requiring "-results" for normal data
-  reader->SetSubDirectory("production");
-  reader->ReadFile("../data/batch_traylist_production.txt"); // read in only real test results
-  reader->ReadDataIV();
-  reader->ReadDataSPS();
+  gDatasets.Use("production"); // only real test results
   makeSurfaceImperfectionCorrelation();
   
   // Check IV reproducibility for "wave-like" correlations
@@ -200,6 +190,18 @@ void systematic_analysis_summary() {
   
 }// End of systematic_analysis_summary::main
 
+
+
+// Declare the datasets of the systematic studies (read on first use)
+// The scans are not stored in "-results" directories
+void registerSystematicDatasets() {
+  if (!gDatasets.Has("repsyst"))    gDatasets.Register("repsyst",    "repsyst",    "../data/syst_traylist_repsyst.txt");
+  if (!gDatasets.Has("vopscan"))    gDatasets.Register("vopscan",    "vopscan",    "../data/syst_traylist_vopscan.txt",   false);
+  if (!gDatasets.Has("tempscan"))   gDatasets.Register("tempscan",   "tempscan",   "../data/syst_traylist_tempscan.txt",  false);
+  if (!gDatasets.Has("cyclescan"))  gDatasets.Register("cyclescan",  "cyclescan",  "../data/syst_traylist_cyclescan.txt", false);
+  if (!gDatasets.Has("production")) gDatasets.Register("production", "production", "../data/batch_traylist_production.txt");
+}// End of systematic_analysis_summary::registerSystematicDatasets
+
 //========================================================================== Reproducibility tests
 
 
@@ -723,18 +725,18 @@ void makeTemperatureScan() {
     if (temp_debug) std::cout << "current tray :: " << gReader->GetIV()->at(tempscan_tray_indices[i_temp])->tray_note << std::endl;
     
     // access relevant data from reader
-    std::vector<int>* current_sipm_row = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->row;
-    std::vector<int>* current_sipm_col = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->col;
+    TrayColumn<int> current_sipm_row = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->row;
+    TrayColumn<int> current_sipm_col = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->col;
     
-    std::vector<float>* current_Vbr_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->IV_Vpeak;
-    std::vector<float>* current_Vbr_25_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->IV_Vpeak_25C;
-    std::vector<float>* current_Vbr_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->SPS_Vbd;
-    std::vector<float>* current_Vbr_25_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->SPS_Vbd_25C;
+    TrayColumn<float> current_Vbr_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->IV_Vpeak;
+    TrayColumn<float> current_Vbr_25_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->IV_Vpeak_25C;
+    TrayColumn<float> current_Vbr_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->SPS_Vbd;
+    TrayColumn<float> current_Vbr_25_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->SPS_Vbd_25C;
     
-    std::vector<float>* current_temp_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->avg_temp;
-    std::vector<float>* current_temp_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->avg_temp;
-    std::vector<float>* current_temp_IV_err = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->stdev_temp;
-    std::vector<float>* current_temp_SPS_err = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->stdev_temp;
+    TrayColumn<float> current_temp_IV = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->avg_temp;
+    TrayColumn<float> current_temp_SPS = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->avg_temp;
+    TrayColumn<float> current_temp_IV_err = gReader->GetIV()->at(tempscan_tray_indices[i_temp])->stdev_temp;
+    TrayColumn<float> current_temp_SPS_err = gReader->GetSPS()->at(tempscan_tray_indices[i_temp])->stdev_temp;
     
     for (int i_sipm = 0; i_sipm < current_Vbr_IV->size(); ++i_sipm) {
       if (current_Vbr_IV->at(i_sipm) == -999) continue;
@@ -1049,12 +1051,12 @@ void makeTemperatureGradientHist() {
     int cycle_pos = gReader->GetTrayStrings()->at(i_tray).find("cycle");
     
     // Define variable arrays
-    std::vector<int>* current_sipm_row = gReader->GetIV()->at(i_tray)->row;
-    std::vector<int>* current_sipm_col = gReader->GetIV()->at(i_tray)->col;
-    std::vector<float>* current_temp_IV = gReader->GetIV()->at(i_tray)->avg_temp;
-    std::vector<float>* current_temp_SPS = gReader->GetSPS()->at(i_tray)->avg_temp;
-    std::vector<float>* current_temp_IV_err = gReader->GetIV()->at(i_tray)->stdev_temp;
-    std::vector<float>* current_temp_SPS_err = gReader->GetSPS()->at(i_tray)->stdev_temp;
+    TrayColumn<int> current_sipm_row = gReader->GetIV()->at(i_tray)->row;
+    TrayColumn<int> current_sipm_col = gReader->GetIV()->at(i_tray)->col;
+    TrayColumn<float> current_temp_IV = gReader->GetIV()->at(i_tray)->avg_temp;
+    TrayColumn<float> current_temp_SPS = gReader->GetSPS()->at(i_tray)->avg_temp;
+    TrayColumn<float> current_temp_IV_err = gReader->GetIV()->at(i_tray)->stdev_temp;
+    TrayColumn<float> current_temp_SPS_err = gReader->GetSPS()->at(i_tray)->stdev_temp;
     
     // array of temperature values at cassette locations
     float temp_values_IV[8] = {
@@ -1283,18 +1285,18 @@ void makeCycleScan() {
     
     // Gather relevant data from gReader
     syst_box_width.push_back(syst_box_width_to_set);
-    std::vector<int>* current_sipm_row = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->row;
-    std::vector<int>* current_sipm_col = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->col;
+    TrayColumn<int> current_sipm_row = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->row;
+    TrayColumn<int> current_sipm_col = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->col;
     
-    std::vector<float>* current_Vbr_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->IV_Vpeak;
-    std::vector<float>* current_Vbr_25_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->IV_Vpeak_25C;
-    std::vector<float>* current_Vbr_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->SPS_Vbd;
-    std::vector<float>* current_Vbr_25_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->SPS_Vbd_25C;
+    TrayColumn<float> current_Vbr_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->IV_Vpeak;
+    TrayColumn<float> current_Vbr_25_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->IV_Vpeak_25C;
+    TrayColumn<float> current_Vbr_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->SPS_Vbd;
+    TrayColumn<float> current_Vbr_25_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->SPS_Vbd_25C;
     
-    std::vector<float>* current_temp_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->avg_temp;
-    std::vector<float>* current_temp_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->avg_temp;
-    std::vector<float>* current_temp_IV_err = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->stdev_temp;
-    std::vector<float>* current_temp_SPS_err = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->stdev_temp;
+    TrayColumn<float> current_temp_IV = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->avg_temp;
+    TrayColumn<float> current_temp_SPS = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->avg_temp;
+    TrayColumn<float> current_temp_IV_err = gReader->GetIV()->at(cycle_tray_indices[i_cycle])->stdev_temp;
+    TrayColumn<float> current_temp_SPS_err = gReader->GetSPS()->at(cycle_tray_indices[i_cycle])->stdev_temp;
     
     // Allocate data from reader to local arrays
     for (int i_sipm = 0; i_sipm < current_Vbr_IV->size(); ++i_sipm) {
@@ -1681,12 +1683,12 @@ void makeOperatingVoltageScan() {
     
     // Gather relevant data from gReader
     syst_box_width.push_back(syst_box_width_to_set);
-    std::vector<int>* current_sipm_row = gReader->GetIV()->at(vop_tray_indices[i_vop])->row;
-    std::vector<int>* current_sipm_col = gReader->GetIV()->at(vop_tray_indices[i_vop])->col;
-    std::vector<float>* current_Vbr_IV = gReader->GetIV()->at(vop_tray_indices[i_vop])->IV_Vpeak;
-    std::vector<float>* current_Vbr_25_IV = gReader->GetIV()->at(vop_tray_indices[i_vop])->IV_Vpeak_25C;
-    std::vector<float>* current_Vbr_SPS = gReader->GetSPS()->at(vop_tray_indices[i_vop])->SPS_Vbd;
-    std::vector<float>* current_Vbr_25_SPS = gReader->GetSPS()->at(vop_tray_indices[i_vop])->SPS_Vbd_25C;
+    TrayColumn<int> current_sipm_row = gReader->GetIV()->at(vop_tray_indices[i_vop])->row;
+    TrayColumn<int> current_sipm_col = gReader->GetIV()->at(vop_tray_indices[i_vop])->col;
+    TrayColumn<float> current_Vbr_IV = gReader->GetIV()->at(vop_tray_indices[i_vop])->IV_Vpeak;
+    TrayColumn<float> current_Vbr_25_IV = gReader->GetIV()->at(vop_tray_indices[i_vop])->IV_Vpeak_25C;
+    TrayColumn<float> current_Vbr_SPS = gReader->GetSPS()->at(vop_tray_indices[i_vop])->SPS_Vbd;
+    TrayColumn<float> current_Vbr_25_SPS = gReader->GetSPS()->at(vop_tray_indices[i_vop])->SPS_Vbd_25C;
     
     // Allocate data from reader to local arrays
     for (int i_sipm = 0; i_sipm < current_Vbr_IV->size(); ++i_sipm) {
@@ -0,0 +1,120 @@
+//  *--
+//  watch_tray_results.cpp
+//
+//  Live QA while the robot test stand runs: waits for new tray result
+//  directories to land in the data directory, ingests only those trays
+//  and prints their summary (averages, outliers, dark current) and a
+//  pass/fail against the contract outlier margin.
+//  New directories are reported per tray, so a tray whose cassette results
+//  predate the watch is ingested (cassette and robot) when its robot results land.
+//
+//  Usage (from src/):
+//    root -l 'watch_tray_results.cpp("")'            // watch ../data
+//    root -l 'watch_tray_results.cpp("robotcheck")'  // watch ../data/robotcheck
+//  *--
+
+#include "global_vars.hpp"
+#include "SiPMDataReader.hpp"
+#include "SiPMTrayWatcher.hpp"
+#include "sipm_analysis_helper.hpp"
+
+//========================================================================== Global Variables
+
+// Statistics of one ingested tray entry, computed once when it lands
+struct TrayWatchSummary {
+  std::string tray;
+  int         mode;             // 0 cassette, 1 robot
+  int         n_valid;
+  double      avg_Vpeak;        // 25C corrected
+  double      avg_Vbreakdown;   // 25C corrected
+  int         n_outliers_Vpeak;
+  int         n_outliers_Vbreakdown;
+  int         n_dark_over_spec; // Idark at Vbd+4V above Hamamatsu_spec_max_Idark
+  bool        pass;
+};// structdef :: TrayWatchSummary
+
+std::vector<TrayWatchSummary> watch_summaries;
+
+//========================================================================== Forward declarations
+
+TrayWatchSummary summarizeTray(int tray_index);
+void             printTraySummary(const TrayWatchSummary& summary);
+
+//========================================================================== Macro Main
+
+// Main macro method: watch for trays until max_minutes have passed (< 0: until interrupted)
+//  - include_existing: also ingest result directories already present at start
+//  - settle_seconds  : how long the result files must stay unchanged before a tray is read
+void watch_tray_results(const char* subdirectory = "",
+                        bool include_existing = false,
+                        int settle_seconds = 5,
+                        int max_minutes = -1) {
+  SiPMDataReader* reader = new SiPMDataReader();
+  reader->SetQuiet();
+  reader->SetThreads(0);
+  reader->SetSubDirectory(subdirectory);
+
+  // Start from an empty tray list with IV and SPS marked as loaded,
+  // so every appended tray is parsed as soon as it is added
+  reader->ReadDataIV();
+  reader->ReadDataSPS();
+
+  TrayResultWatcher watcher(reader->GetDataDir(), reader->HasSubscriptResults(), include_existing, settle_seconds);
+  std::cout << "Watching " << t_blu << watcher.GetDataDir() << t_def << " for new tray results (";
+  std::cout << (watcher.UsesInotify() ? "inotify" : "polling") << ", " << settle_seconds << "s settle time)." << std::endl;
+
+  std::chrono::steady_clock::time_point stop_time = std::chrono::steady_clock::now() + std::chrono::minutes(max_minutes);
+  while (max_minutes < 0 || std::chrono::steady_clock::now() < stop_time) {
+    int timeout_ms = -1;
+    if (max_minutes >= 0) timeout_ms = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(stop_time - std::chrono::steady_clock::now()).count());
+    std::vector<std::string> new_trays = watcher.WaitForTrays(timeout_ms);
+    if (new_trays.empty()) continue;
+
+    // Ingest only the new trays; summaries of earlier trays are kept as they are
+    int n_loaded = reader->GetTrayStrings()->size();
+    reader->AppendTrays(new_trays);
+    for (int i_tray = n_loaded; i_tray < reader->GetTrayStrings()->size(); ++i_tray) {
+      watch_summaries.push_back(summarizeTray(i_tray));
+      printTraySummary(watch_summaries.back());
+    }
+
+    int n_pass = 0;
+    for (int i = 0; i < watch_summaries.size(); ++i) n_pass += watch_summaries[i].pass;
+    std::cout << "Trays this session: " << t_grn << n_pass << t_def << '/' << watch_summaries.size() << " passing." << std::endl;
+  }// End of watch loop
+
+  return;
+}// End of watch_tray_results::main
+
+//========================================================================== Tray summaries
+
+// Compute the QA summary of one tray entry in gReader
+TrayWatchSummary summarizeTray(int tray_index) {
+  TrayWatchSummary summary;
+  summary.tray = gReader->GetTrayStrings()->at(tray_index);
+  summary.mode = gReader->GetTrayModes()->at(tray_index);
+  summary.n_valid = countValidSiPMs(tray_index);
+  summary.avg_Vpeak = getAvgVpeak(tray_index, true);
+  summary.avg_Vbreakdown = getAvgVbreakdown(tray_index, true);
+  summary.n_outliers_Vpeak = countOutliersVpeak(tray_index, true);
+  summary.n_outliers_Vbreakdown = countOutliersVbreakdown(tray_index, true);
+  summary.n_dark_over_spec = maskedCountAbove(gReader->GetIV()->at(tray_index)->Idark_4above, Hamamatsu_spec_max_Idark);
+
+  // Contract: at most contract_outlier_margin_percent of the SiPMs may be outliers
+  double allowed_outliers = 0.01 * contract_outlier_margin_percent * summary.n_valid;
+  summary.pass = summary.n_valid > 0
+              && summary.n_outliers_Vpeak <= allowed_outliers
+              && summary.n_outliers_Vbreakdown <= allowed_outliers;
+  return summary;
+}// End of watch_tray_results::summarizeTray
+
+
+
+void printTraySummary(const TrayWatchSummary& summary) {
+  std::cout << "Tray " << (summary.mode ? t_cyn : t_grn) << summary.tray << t_def << (summary.mode ? " (robot)" : " (cassette)");
+  std::cout << " :: " << summary.n_valid << " SiPMs, V_peak(25C) " << summary.avg_Vpeak << " V, V_bd(25C) " << summary.avg_Vbreakdown << " V";
+  std::cout << ", outliers IV/SPS " << t_mgn << summary.n_outliers_Vpeak << t_def << '/' << t_mgn << summary.n_outliers_Vbreakdown << t_def;
+  std::cout << ", " << summary.n_dark_over_spec << " over Idark spec :: ";
+  if (summary.pass) std::cout << t_grn << "PASS" << t_def << std::endl;
+  else              std::cout << t_red << "FAIL" << t_def << std::endl;
+}// End of watch_tray_results::printTraySummary